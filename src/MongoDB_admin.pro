@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -39,6 +39,12 @@ SOURCES += \
         $$PWD/mongodb_table_roles_delegate.cpp \
         $$PWD/mongodb_logger.cpp \
         $$PWD/mongodb_document.cpp \
+        $$PWD/mongodb_document_cursor.cpp \
+        $$PWD/mongodb_document_arena.cpp \
+        $$PWD/mongodb_document_cache.cpp \
+        $$PWD/mongodb_json_reader.cpp \
+        $$PWD/mongodb_json_writer.cpp \
+        $$PWD/mongodb_schema.cpp \
         $$PWD/mongodb_gui_admin.cpp \
         $$PWD/mongodb_gui_credentials_dialog.cpp \
         $$PWD/mongodb_gui_document.cpp
@@ -50,6 +56,12 @@ HEADERS += \
         $$PWD/mongodb_table_roles_delegate.h \
         $$PWD/mongodb_logger.h \
         $$PWD/mongodb_document.h \
+        $$PWD/mongodb_document_cursor.h \
+        $$PWD/mongodb_document_arena.h \
+        $$PWD/mongodb_document_cache.h \
+        $$PWD/mongodb_json_reader.h \
+        $$PWD/mongodb_json_writer.h \
+        $$PWD/mongodb_schema.h \
         $$PWD/mongodb_structures.h \
         $$PWD/mongodb_gui_admin.h \
         $$PWD/mongodb_gui_credentials_dialog.h \
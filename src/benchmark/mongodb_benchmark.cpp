@@ -0,0 +1,294 @@
+/// \cond
+#include <QCoreApplication>
+#include <QDebug>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+#include <bsoncxx/builder/basic/array.hpp>
+#include <bsoncxx/builder/basic/document.hpp>
+#include <bsoncxx/builder/basic/kvp.hpp>
+#include <bsoncxx/types.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+/// \endcond
+
+#include <mongodb_document.h>
+
+/*
+ * Benchmark of the conversion paths of mongodb_document. Documents from 100 bytes to 15 MB are generated with
+ * three shapes (flat, nested and array heavy), and for each path the throughput (MB/s of BSON) and the number
+ * of heap allocations (malloc, calloc and realloc calls, glibc only) per call are reported.
+ *
+ * Usage: MongoDB_benchmark [--time <ms per measurement>] [--max-size <bytes>]
+ */
+
+// Allocation counter. malloc, calloc and realloc are replaced in the executable, so the calls made by Qt (QArrayData),
+// libbson (bson_malloc) and operator new all go through them. The real allocator is reached through the glibc
+// __libc_* entry points, other C libraries don't provide them and the allocations are not measured.
+static std::atomic<qint64> allocation_count{0};
+
+#if defined(__GLIBC__)
+#define ALLOCATIONS_MEASURED 1
+
+extern "C"
+{
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *pointer, std::size_t size);
+
+void *malloc(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(std::size_t count, std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+#define ALLOCATIONS_MEASURED 0
+#endif
+
+using bsoncxx::builder::basic::kvp;
+
+/**
+ * Append one unit of a flat document: a string, an integer, a double and a boolean.
+ *
+ * @param builder Builder of the document.
+ * @param index Index of the unit, used for the keys.
+ *
+ **/
+static void appendFlatUnit(bsoncxx::builder::basic::document &builder, int index)
+{
+    std::string key = std::to_string(index);
+    builder.append(kvp("name_" + key, "value of the field number " + key),
+                   kvp("count_" + key, index),
+                   kvp("ratio_" + key, index * 0.25),
+                   kvp("valid_" + key, index % 2 == 0));
+}
+
+/**
+ * Append one unit of a nested document: a sub document three levels deep.
+ *
+ * @param builder Builder of the document.
+ * @param index Index of the unit, used for the keys.
+ *
+ **/
+static void appendNestedUnit(bsoncxx::builder::basic::document &builder, int index)
+{
+    std::string key = std::to_string(index);
+    builder.append(kvp("level1_" + key, [index](bsoncxx::builder::basic::sub_document level1)
+    {
+        level1.append(kvp("id", index));
+        level1.append(kvp("level2", [index](bsoncxx::builder::basic::sub_document level2)
+        {
+            level2.append(kvp("label", "nested value"));
+            level2.append(kvp("level3", [index](bsoncxx::builder::basic::sub_document level3)
+            {
+                level3.append(kvp("value", std::int64_t(index) * 1000003), kvp("score", index / 3.0));
+            }));
+        }));
+    }));
+}
+
+/**
+ * Append one unit of an array heavy document: an array of numbers and an array of small documents.
+ *
+ * @param builder Builder of the document.
+ * @param index Index of the unit, used for the keys.
+ *
+ **/
+static void appendArrayUnit(bsoncxx::builder::basic::document &builder, int index)
+{
+    std::string key = std::to_string(index);
+    builder.append(kvp("numbers_" + key, [index](bsoncxx::builder::basic::sub_array numbers)
+    {
+        for(int i = 0; i < 16; i++)
+        {
+            numbers.append(index + i);
+        }
+    }));
+    builder.append(kvp("items_" + key, [index](bsoncxx::builder::basic::sub_array items)
+    {
+        for(int i = 0; i < 4; i++)
+        {
+            items.append([index, i](bsoncxx::builder::basic::sub_document item)
+            {
+                item.append(kvp("position", i), kvp("tag", "item"), kvp("weight", (index + i) * 0.5));
+            });
+        }
+    }));
+}
+
+/**
+ * Generate a document with the given shape and approximately the given size.
+ *
+ * @param append Function that appends one unit of the shape.
+ * @param target_size Size of the BSON document in bytes.
+ * @return document Generated document.
+ *
+ **/
+static BsoncxxDocVal generateDocument(std::function<void(bsoncxx::builder::basic::document&, int)> append, qint64 target_size)
+{
+    auto build = [&append](int units)
+    {
+        bsoncxx::builder::basic::document builder{};
+        builder.append(kvp("_id", bsoncxx::oid{}));
+        for(int i = 0; i < units; i++)
+        {
+            append(builder, i);
+        }
+        return builder.extract();
+    };
+
+    // Measure the size of one unit and scale the number of units to the target size
+    BsoncxxDocVal sample = build(1);
+    BsoncxxDocVal empty = build(0);
+    qint64 unit_size = qint64(sample.length() - empty.length());
+    int units = int(std::max<qint64>(1, (target_size - qint64(empty.length())) / unit_size));
+    return build(units);
+}
+
+/**
+ * Run a conversion path repeatedly during the given time.
+ *
+ * @param name Name of the path.
+ * @param bson_size Size of the BSON document, used to compute the throughput.
+ * @param min_time_ms Minimum duration of the measurement.
+ * @param function Function that runs the path once.
+ * @param output Stream where the result is written.
+ *
+ **/
+static void measure(QString name, qint64 bson_size, qint64 min_time_ms, std::function<void()> function, QTextStream &output)
+{
+    // One call to warm up the caches
+    function();
+
+    qint64 iterations = 0;
+    qint64 allocations_start = allocation_count.load();
+    QElapsedTimer timer;
+    timer.start();
+    do
+    {
+        function();
+        iterations++;
+    }
+    while(timer.elapsed() < min_time_ms || iterations < 3);
+    qint64 elapsed_ns = timer.nsecsElapsed();
+    qint64 allocations = allocation_count.load() - allocations_start;
+
+    double seconds = double(elapsed_ns) / 1e9;
+    double megabytes = double(bson_size) * double(iterations) / (1024.0 * 1024.0);
+
+    output << "    " << name.leftJustified(16)
+           << QString::number(megabytes / seconds, 'f', 1).rightJustified(10) << " MB/s"
+           << QString::number(double(elapsed_ns) / double(iterations) / 1000.0, 'f', 1).rightJustified(14) << " us/call"
+           << (ALLOCATIONS_MEASURED ? QString::number(double(allocations) / double(iterations), 'f', 1).rightJustified(14) + " allocs/call" : QString("    allocs/call not measured"))
+           << "\n";
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("Mongodb Manager benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmark of the mongodb_document conversions");
+    parser.addHelpOption();
+    QCommandLineOption timeOption(QStringList() << "t" << "time", QCoreApplication::translate("main", "Minimum duration of each measurement in milliseconds (default 500)."), QCoreApplication::translate("main", "ms"), "500");
+    parser.addOption(timeOption);
+    QCommandLineOption sizeOption(QStringList() << "s" << "max-size", QCoreApplication::translate("main", "Maximum size of the generated documents in bytes (default 15000000)."), QCoreApplication::translate("main", "bytes"), "15000000");
+    parser.addOption(sizeOption);
+    parser.process(a);
+
+    qint64 min_time_ms = parser.value(timeOption).toLongLong();
+    qint64 max_size = parser.value(sizeOption).toLongLong();
+
+    QTemporaryDir temporary_dir;
+    if(!temporary_dir.isValid())
+    {
+        qCritical() << "Could not create a temporary directory";
+        return 1;
+    }
+    QString file_path = temporary_dir.filePath("benchmark.json");
+
+    struct shape
+    {
+        QString name;
+        std::function<void(bsoncxx::builder::basic::document&, int)> append;
+    };
+    std::vector<shape> shapes = {{"flat", appendFlatUnit}, {"nested", appendNestedUnit}, {"array", appendArrayUnit}};
+    std::vector<qint64> sizes = {100, 1000, 10000, 100000, 1000000, 15000000};
+
+    QTextStream output(stdout);
+
+    for(const shape &current_shape : shapes)
+    {
+        for(qint64 size : sizes)
+        {
+            if(size > max_size)
+            {
+                continue;
+            }
+
+            BsoncxxDocVal bson = generateDocument(current_shape.append, size);
+            qint64 bson_size = qint64(bson.length());
+
+            // Documents that come from MongoDB keep the BSON, the ones created by the GUI only have the Json form
+            mongodb_document bson_document(bson.view());
+            mongodb_document json_document(bson_document.getDoc());
+
+            output << current_shape.name << " document, " << bson_size << " bytes" << "\n";
+
+            measure("fromBsoncxx", bson_size, min_time_ms, [&]()
+            {
+                QJsonObject object = json_document.fromBsoncxx(bson.view());
+            }, output);
+
+            measure("toBsoncxxDocVal", bson_size, min_time_ms, [&]()
+            {
+                mongodb_document document(json_document.getDoc());
+                BsoncxxDocVal value = document.toBsoncxxDocVal();
+            }, output);
+
+            measure("toQString", bson_size, min_time_ms, [&]()
+            {
+                // A new document each time, otherwise the BSON built by the first call is reused
+                mongodb_document document(json_document.getDoc());
+                QString text = document.toQString();
+            }, output);
+
+            measure("saveToDisk", bson_size, min_time_ms, [&]()
+            {
+                bson_document.saveToDisk(file_path);
+            }, output);
+
+            measure("loadFromDisk", bson_size, min_time_ms, [&]()
+            {
+                mongodb_document document;
+                document.loadFromDisk(file_path);
+            }, output);
+
+            output << "\n";
+            output.flush();
+        }
+    }
+
+    return 0;
+}
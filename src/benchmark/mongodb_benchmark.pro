@@ -0,0 +1,36 @@
+#-------------------------------------------------
+#
+# Benchmark of the mongodb_document conversions
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = MongoDB_benchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+DESTDIR = ../../bin
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+INCLUDEPATH += \
+    $$PWD/.. \
+    -I /usr/local/include/mongocxx/v_noabi/mongocxx \
+    -I /usr/local/include/bsoncxx/v_noabi/bsoncxx\
+    -I /usr/local/include/libbson-1.0/bson \
+    -I /usr/local/include/libmongoc-1.0 \
+    -I /usr/local/lib
+
+LIBS += -L /usr/local/lib -lmongocxx -lbsoncxx
+
+SOURCES += \
+        $$PWD/mongodb_benchmark.cpp \
+        $$PWD/../mongodb_document.cpp \
+        $$PWD/../mongodb_json_writer.cpp
+
+HEADERS += \
+        $$PWD/../mongodb_document.h \
+        $$PWD/../mongodb_json_writer.h
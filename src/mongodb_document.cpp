@@ -1,12 +1,23 @@
 /// \cond
+#include <QBuffer>
+#include <QDateTime>
 #include <QFile>
-#include <QTextStream>
+#include <QLocale>
+#include <QRegularExpression>
 
+#include <bsoncxx/decimal128.hpp>
+#include <bsoncxx/exception/exception.hpp>
 #include <bsoncxx/json.hpp>
 #include <bsoncxx/builder/stream/document.hpp>
+#include <bsoncxx/types.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <limits>
 /// \endcond
 ///
 #include <mongodb_document.h>
+#include <mongodb_json_writer.h>
 
 /**
  * Constructor of the class.
@@ -23,11 +34,22 @@ mongodb_document::mongodb_document()
  * @param document File containing the document.
  *
  **/
-mongodb_document::mongodb_document(QJsonObject document):
+mongodb_document::mongodb_document(const QJsonObject &document):
     _document(document)
 {
 }
 
+/**
+ * Constructor of the class.
+ *
+ * @param document File containing the document (its content is moved into the new document).
+ *
+ **/
+mongodb_document::mongodb_document(QJsonObject &&document):
+    _document(std::move(document))
+{
+}
+
 /**
  * Constructor of the class.
  *
@@ -36,7 +58,35 @@ mongodb_document::mongodb_document(QJsonObject document):
  **/
 mongodb_document::mongodb_document(BsoncxxDocView document)
 {
-    _document = mongodb_document::fromBsoncxx(document);
+    // Only the bytes are copied, the Json form is built on demand
+    mongodb_document::setBson(BsoncxxDocVal(document));
+}
+
+/**
+ * Constructor of the class.
+ *
+ * @param document File containing the document (it is moved into the new document without any conversion).
+ *
+ **/
+mongodb_document::mongodb_document(BsoncxxDocVal &&document)
+{
+    mongodb_document::setBson(std::move(document));
+}
+
+/**
+ * Constructor of the class. The document shares a BSON buffer owned by someone else (e.g. the
+ * mongodb_document_arena of a cursor batch), so nothing is copied or allocated.
+ *
+ * @param bson Pointer to the BSON of the document, it keeps the owner of the buffer alive.
+ * @param length Length of the BSON document.
+ *
+ **/
+mongodb_document::mongodb_document(std::shared_ptr<const std::uint8_t> bson, std::size_t length):
+    _json_loaded(false),
+    _bson(std::move(bson)),
+    _bson_length(length)
+{
+
 }
 
 /**
@@ -45,7 +95,7 @@ mongodb_document::mongodb_document(BsoncxxDocView document)
  * @param document File containing the document.
  *
  **/
-mongodb_document::mongodb_document(std::string document)
+mongodb_document::mongodb_document(const std::string &document)
 {
     _document = mongodb_document::fromStdString(document);
 }
@@ -56,8 +106,9 @@ mongodb_document::mongodb_document(std::string document)
  * @param document File containing the document.
  *
  **/
-QJsonObject mongodb_document::getDoc()
+QJsonObject mongodb_document::getDoc() const
 {
+    mongodb_document::loadJson();
     return _document;
 }
 
@@ -67,7 +118,7 @@ QJsonObject mongodb_document::getDoc()
  * @param document File containing the document.
  *
  **/
-mongodb_document::mongodb_document(QString document)
+mongodb_document::mongodb_document(const QString &document)
 {
     _document = mongodb_document::fromQString(document);
 }
@@ -78,7 +129,7 @@ mongodb_document::mongodb_document(QString document)
  * @param document File containing the document.
  *
  **/
-mongodb_document::mongodb_document(QByteArray document)
+mongodb_document::mongodb_document(const QByteArray &document)
 {
     _document = mongodb_document::fromQByteArray(document);
 }
@@ -89,7 +140,7 @@ mongodb_document::mongodb_document(QByteArray document)
  * @param document File containing the document.
  *
  **/
-mongodb_document::mongodb_document(QJsonDocument document)
+mongodb_document::mongodb_document(const QJsonDocument &document)
 {
     _document = mongodb_document::fromQJsonDocument(document);
 }
@@ -101,16 +152,32 @@ mongodb_document::mongodb_document(QJsonDocument document)
  * @return id Id of the document.
  *
  **/
-QString mongodb_document::getId()
+QString mongodb_document::getId() const
 {
+    if(_bson)
+    {
+        return mongodb_document::getIdFromBsoncxx(mongodb_document::getBsonView());
+    }
+
     QJsonValue id_Val = _document.value("_id");
     QJsonObject id_Object = id_Val.toObject();
     QJsonValue oid_Val = id_Object.value("$oid");
     QString output = oid_Val.toString();
 
+    // Int64 ids are stored as {"$numberLong": "<number>"}
     if(output == "")
     {
-        if(id_Val.toString() == "")
+        output = id_Object.value("$numberLong").toString();
+    }
+
+    if(output == "")
+    {
+        if(id_Val.isDouble())
+        {
+            // Numeric ids are written without decimals when they are integers.
+            return QString::number(id_Val.toDouble(), 'g', QLocale::FloatingPointShortest);
+        }
+        else if(id_Val.toString() == "")
         {
             return "NULL";
         }
@@ -126,13 +193,209 @@ QString mongodb_document::getId()
     }
 }
 
+/**
+ * Get the MongoDB id of a BSON document without converting it to Json. The id is formatted the same
+ * way as in getId().
+ *
+ * @param document BSON document (only the _id field is read).
+ * @return id Id of the document.
+ *
+ **/
+QString mongodb_document::getIdFromBsoncxx(BsoncxxDocView document)
+{
+    bsoncxx::document::element id = document["_id"];
+
+    if(!id)
+    {
+        return "NULL";
+    }
+
+    return mongodb_document::getIdFromBsoncxxValue(id.get_value());
+}
+
+/**
+ * Format a BSON _id value the same way as getIdFromBsoncxx().
+ *
+ * @param id Value of the _id field.
+ * @return id Id as text.
+ *
+ **/
+QString mongodb_document::getIdFromBsoncxxValue(const bsoncxx::types::bson_value::view &id)
+{
+    switch(id.type())
+    {
+    case bsoncxx::type::k_oid:
+        return QString::fromStdString(id.get_oid().value.to_string());
+    case bsoncxx::type::k_utf8:
+    {
+        bsoncxx::stdx::string_view id_string = id.get_utf8().value;
+        if(id_string.empty())
+        {
+            return "NULL";
+        }
+        return QString::fromUtf8(id_string.data(), int(id_string.size()));
+    }
+    case bsoncxx::type::k_int32:
+        return QString::number(id.get_int32().value);
+    case bsoncxx::type::k_int64:
+        return QString::number(qint64(id.get_int64().value));
+    case bsoncxx::type::k_double:
+        return QString::number(id.get_double().value, 'g', QLocale::FloatingPointShortest);
+    default:
+        return "NULL";
+    }
+}
+
+/**
+ * Check if the document has no content (e.g. it was not found in the database).
+ *
+ * @return True if the document is empty, false otherwise.
+ *
+ **/
+bool mongodb_document::isEmpty() const
+{
+    if(_bson)
+    {
+        // An empty BSON document has 5 bytes (length and terminator)
+        return _bson_length <= 5;
+    }
+    return _document.isEmpty();
+}
+
+/**
+ * Check if the document holds its original BSON, so it can be written back to MongoDB without any conversion.
+ *
+ * @return True if the document holds BSON, false otherwise.
+ *
+ **/
+bool mongodb_document::hasBson() const
+{
+    return bool(_bson);
+}
+
+/**
+ * Estimate the memory used by the document: its BSON plus, if it has been built, its Json form.
+ *
+ * @return Approximate size in bytes.
+ *
+ **/
+qint64 mongodb_document::getMemorySize() const
+{
+    qint64 size = qint64(sizeof(mongodb_document));
+    if(_bson)
+    {
+        size += qint64(_bson_length);
+    }
+    if(_json_loaded)
+    {
+        size += mongodb_document::estimateJsonSize(_document);
+    }
+    return size;
+}
+
+/**
+ * Estimate the memory used by a Json value: a fixed overhead per value plus the UTF-16 keys and strings.
+ *
+ * @param input Json value.
+ * @return Approximate size in bytes.
+ *
+ **/
+qint64 mongodb_document::estimateJsonSize(const QJsonValue &input)
+{
+    const qint64 VALUE_OVERHEAD = 16;
+    qint64 size = VALUE_OVERHEAD;
+
+    if(input.isObject())
+    {
+        QJsonObject object = input.toObject();
+        for(QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+        {
+            size += 2 * qint64(it.key().size()) + mongodb_document::estimateJsonSize(it.value());
+        }
+    }
+    else if(input.isArray())
+    {
+        for(const QJsonValue &value : input.toArray())
+        {
+            size += mongodb_document::estimateJsonSize(value);
+        }
+    }
+    else if(input.isString())
+    {
+        size += 2 * qint64(input.toString().size());
+    }
+    return size;
+}
+
+/**
+ * Store the BSON of the document. The Json form will be built when it is needed.
+ *
+ * @param document BSON document.
+ *
+ **/
+void mongodb_document::setBson(BsoncxxDocVal &&document)
+{
+    mongodb_document::storeBson(std::move(document));
+    _document = QJsonObject();
+    _json_loaded = false;
+}
+
+/**
+ * Keep the BSON of the document next to its Json form (both represent the same content).
+ *
+ * @param document BSON document.
+ *
+ **/
+void mongodb_document::storeBson(BsoncxxDocVal &&document) const
+{
+    std::shared_ptr<BsoncxxDocVal> owner = std::make_shared<BsoncxxDocVal>(std::move(document));
+    _bson_length = owner->view().length();
+    // The pointer shares the ownership of the BSON value
+    _bson = std::shared_ptr<const std::uint8_t>(owner, owner->view().data());
+}
+
+/**
+ * Get a view of the BSON of the document (only valid if the document holds BSON).
+ *
+ * @return View of the document.
+ *
+ **/
+BsoncxxDocView mongodb_document::getBsonView() const
+{
+    return BsoncxxDocView(_bson.get(), _bson_length);
+}
+
+/**
+ * Build the Json form of the document from its BSON, if it has not been built yet.
+ *
+ **/
+void mongodb_document::loadJson() const
+{
+    if(!_json_loaded && _bson)
+    {
+        _document = mongodb_document::fromBsoncxxDocument(mongodb_document::getBsonView());
+    }
+    _json_loaded = true;
+}
+
+/**
+ * Keep only the Json form of the document. Used before modifying it, since the BSON would become outdated.
+ *
+ **/
+void mongodb_document::dropBson()
+{
+    mongodb_document::loadJson();
+    _bson.reset();
+    _bson_length = 0;
+}
+
 /**
  * Get the MongoDB id of the document in GridFS format (For files larger than 16Mb).
  *
  * @return id Id of the document.
  *
  **/
-bsoncxx::types::bson_value::value mongodb_document::getIdGridfsFormat()
+bsoncxx::types::bson_value::value mongodb_document::getIdGridfsFormat() const
 {
     QString id = mongodb_document::getId();
     // Build a valid mongodb id structure
@@ -153,7 +416,7 @@ bsoncxx::types::bson_value::value mongodb_document::getIdGridfsFormat()
  * @return document.
  *
  **/
-QJsonObject mongodb_document::updateDocumentId(QString id)
+QJsonObject mongodb_document::updateDocumentId(const QString &id)
 {
     QString MONGO_ID = "mongo_id_format";
 
@@ -164,6 +427,7 @@ QJsonObject mongodb_document::updateDocumentId(QString id)
 
     // Take the value of the key "_id": it is a ObjectId type
     QJsonValue newid = newobj_id.take("_id");
+    mongodb_document::dropBson();
     // Remove previous id if there is one
     _document.remove(QString("_id"));
     // Add the given id with the correct format
@@ -178,24 +442,30 @@ QJsonObject mongodb_document::updateDocumentId(QString id)
  * @return output Converted document.
  *
  **/
-BsoncxxDocVal mongodb_document::toBsoncxxDocVal()
+BsoncxxDocVal mongodb_document::toBsoncxxDocVal() const
 {
-    std::string output_stdString = mongodb_document::toStdString();
-    BsoncxxDocVal output = bsoncxx::from_json(output_stdString);
-    return output;
+    if(_bson)
+    {
+        return BsoncxxDocVal(mongodb_document::getBsonView());
+    }
+    return mongodb_document::toBsoncxxDocument(_document);
 }
 
 /**
- * Convert documnet to BsoncxxDocView.
+ * Convert documnet to BsoncxxDocView. The view points to a buffer owned by the document, so it is valid
+ * while the document exists and is not modified.
  *
  * @return output Converted document.
  *
  **/
-BsoncxxDocView mongodb_document::toBsoncxxDocView()
+BsoncxxDocView mongodb_document::toBsoncxxDocView() const
 {
-    std::string output_stdString = mongodb_document::toStdString();
-    BsoncxxDocVal output = bsoncxx::from_json(output_stdString);
-    return output.view();
+    if(!_bson)
+    {
+        // Build the BSON once and keep it together with the Json form
+        mongodb_document::storeBson(mongodb_document::toBsoncxxDocument(_document));
+    }
+    return mongodb_document::getBsonView();
 }
 
 /**
@@ -204,10 +474,10 @@ BsoncxxDocView mongodb_document::toBsoncxxDocView()
  * @return output Converted document.
  *
  **/
-QString mongodb_document::toQString()
+QString mongodb_document::toQString() const
 {
-    std::string output = mongodb_document::toStdString();
-    return  QString::fromStdString(output);
+    QByteArray output = mongodb_document::toQByteArray();
+    return  QString::fromUtf8(output);
 }
 
 /**
@@ -216,8 +486,9 @@ QString mongodb_document::toQString()
  * @return output Converted document.
  *
  **/
-QVariantMap mongodb_document::toQVariantMap()
+QVariantMap mongodb_document::toQVariantMap() const
 {
+    mongodb_document::loadJson();
     return _document.toVariantMap();
 }
 
@@ -227,22 +498,29 @@ QVariantMap mongodb_document::toQVariantMap()
  * @return output Converted document.
  *
  **/
-std::string mongodb_document::toStdString()
+std::string mongodb_document::toStdString() const
 {
     QByteArray output = mongodb_document::toQByteArray();
     return  output.toStdString();
 }
 
 /**
- * Convert documnet to QByteArray.
+ * Convert documnet to QByteArray. The Json is written from the BSON by mongodb_json_writer, like the files saved
+ * with saveToDisk(), so every text form of the document uses the same type mapping.
  *
  * @return output Converted document.
  *
  **/
-QByteArray mongodb_document::toQByteArray()
+QByteArray mongodb_document::toQByteArray() const
 {
-    QJsonDocument output_QJsonDoc =  mongodb_document::toQJsonDocument();
-    QByteArray output(output_QJsonDoc.toJson());
+    QByteArray output;
+    QBuffer buffer(&output);
+    buffer.open(QIODevice::WriteOnly);
+    {
+        mongodb_json_writer writer(&buffer);
+        writer.writeDocument(mongodb_document::toBsoncxxDocView());
+        writer.writeRaw("\n");
+    }
     return output;
 }
 
@@ -252,8 +530,9 @@ QByteArray mongodb_document::toQByteArray()
  * @return output Converted document.
  *
  **/
-QJsonDocument mongodb_document::toQJsonDocument()
+QJsonDocument mongodb_document::toQJsonDocument() const
 {
+    mongodb_document::loadJson();
     QJsonDocument output(_document);
     return output;
 }
@@ -264,7 +543,7 @@ QJsonDocument mongodb_document::toQJsonDocument()
  * @return output Converted document.
  *
  **/
-QJsonObject mongodb_document::fromQJsonDocument(QJsonDocument input)
+QJsonObject mongodb_document::fromQJsonDocument(const QJsonDocument &input) const
 {
     return input.object();
 }
@@ -275,7 +554,7 @@ QJsonObject mongodb_document::fromQJsonDocument(QJsonDocument input)
  * @return output Converted document.
  *
  **/
-QJsonObject mongodb_document::fromQByteArray(QByteArray input)
+QJsonObject mongodb_document::fromQByteArray(const QByteArray &input) const
 {
     QJsonDocument output = QJsonDocument::fromJson(input);
     return mongodb_document::fromQJsonDocument(output);
@@ -287,7 +566,7 @@ QJsonObject mongodb_document::fromQByteArray(QByteArray input)
  * @return output Converted document.
  *
  **/
-QJsonObject mongodb_document::fromQString(QString input)
+QJsonObject mongodb_document::fromQString(const QString &input) const
 {
     QByteArray output = input.toLocal8Bit();
     return mongodb_document::fromQByteArray(output);
@@ -299,33 +578,476 @@ QJsonObject mongodb_document::fromQString(QString input)
  * @return output Converted document.
  *
  **/
-QJsonObject mongodb_document::fromStdString(std::string input)
+QJsonObject mongodb_document::fromStdString(const std::string &input) const
 {
     QString output = QString::fromStdString(input);
     return mongodb_document::fromQString(output);
 }
 
+/**
+ * Convert a BSON document to Json. The elements are converted directly, without an intermediate Json string.
+ * The BSON types that Json can't represent use the MongoDB extended Json (canonical) format:
+ *
+ * ObjectId -> {"$oid": "<hex>"}
+ * Date     -> {"$date": {"$numberLong": "<milliseconds>"}}
+ * Int64    -> {"$numberLong": "<number>"}
+ * Binary   -> {"$binary": {"base64": "<data>", "subType": "<hex>"}}
+ *
+ * @param input Document to be converted.
+ * @return output Converted document.
+ *
+ **/
+QJsonObject mongodb_document::fromBsoncxxDocument(BsoncxxDocView input)
+{
+    QJsonObject output;
+    for(const bsoncxx::document::element &element : input)
+    {
+        bsoncxx::stdx::string_view key = element.key();
+        output.insert(QString::fromUtf8(key.data(), int(key.size())), mongodb_document::fromBsoncxxValue(element.get_value()));
+    }
+    return output;
+}
+
+/**
+ * Convert a BSON array to Json (see fromBsoncxxDocument()).
+ *
+ * @param input Array to be converted.
+ * @return output Converted array.
+ *
+ **/
+QJsonArray mongodb_document::fromBsoncxxArray(bsoncxx::array::view input)
+{
+    QJsonArray output;
+    for(const bsoncxx::array::element &element : input)
+    {
+        output.append(mongodb_document::fromBsoncxxValue(element.get_value()));
+    }
+    return output;
+}
+
+/**
+ * Convert a BSON value to a Json value (see fromBsoncxxDocument()). This is the only mapping of the BSON types,
+ * mongodb_json_writer uses it for the types that Json can't represent. Json numbers don't tell an integral double
+ * from an integer, the writer keeps that difference in the text (e.g. 1.0).
+ *
+ * @param input Value to be converted.
+ * @return output Converted value.
+ *
+ **/
+QJsonValue mongodb_document::fromBsoncxxValue(const bsoncxx::types::bson_value::view &input)
+{
+    switch(input.type())
+    {
+    case bsoncxx::type::k_double:
+    {
+        double value = input.get_double().value;
+        if(std::isfinite(value))
+        {
+            return value;
+        }
+        // Json numbers can't be NaN or infinite
+        QString special = std::isnan(value) ? "NaN" : (value > 0 ? "Infinity" : "-Infinity");
+        return QJsonObject{{"$numberDouble", special}};
+    }
+    case bsoncxx::type::k_utf8:
+    {
+        bsoncxx::stdx::string_view value = input.get_utf8().value;
+        return QString::fromUtf8(value.data(), int(value.size()));
+    }
+    case bsoncxx::type::k_document:
+        return mongodb_document::fromBsoncxxDocument(input.get_document().value);
+    case bsoncxx::type::k_array:
+        return mongodb_document::fromBsoncxxArray(input.get_array().value);
+    case bsoncxx::type::k_binary:
+    {
+        bsoncxx::types::b_binary value = input.get_binary();
+        QByteArray data(reinterpret_cast<const char*>(value.bytes), int(value.size));
+        QString sub_type = QString("%1").arg(static_cast<int>(value.sub_type), 2, 16, QChar('0'));
+        return QJsonObject{{"$binary", QJsonObject{{"base64", QString::fromLatin1(data.toBase64())}, {"subType", sub_type}}}};
+    }
+    case bsoncxx::type::k_undefined:
+        return QJsonObject{{"$undefined", true}};
+    case bsoncxx::type::k_oid:
+        return QJsonObject{{"$oid", QString::fromStdString(input.get_oid().value.to_string())}};
+    case bsoncxx::type::k_bool:
+        return input.get_bool().value;
+    case bsoncxx::type::k_date:
+        return QJsonObject{{"$date", QJsonObject{{"$numberLong", QString::number(qint64(input.get_date().to_int64()))}}}};
+    case bsoncxx::type::k_null:
+        return QJsonValue(QJsonValue::Null);
+    case bsoncxx::type::k_regex:
+    {
+        bsoncxx::types::b_regex value = input.get_regex();
+        return QJsonObject{{"$regularExpression", QJsonObject{{"pattern", QString::fromUtf8(value.regex.data(), int(value.regex.size()))},
+                                                              {"options", QString::fromUtf8(value.options.data(), int(value.options.size()))}}}};
+    }
+    case bsoncxx::type::k_dbpointer:
+    {
+        bsoncxx::types::b_dbpointer value = input.get_dbpointer();
+        return QJsonObject{{"$dbPointer", QJsonObject{{"$ref", QString::fromUtf8(value.collection.data(), int(value.collection.size()))},
+                                                      {"$id", QJsonObject{{"$oid", QString::fromStdString(value.value.to_string())}}}}}};
+    }
+    case bsoncxx::type::k_code:
+    {
+        bsoncxx::stdx::string_view value = input.get_code().code;
+        return QJsonObject{{"$code", QString::fromUtf8(value.data(), int(value.size()))}};
+    }
+    case bsoncxx::type::k_symbol:
+    {
+        bsoncxx::stdx::string_view value = input.get_symbol().symbol;
+        return QJsonObject{{"$symbol", QString::fromUtf8(value.data(), int(value.size()))}};
+    }
+    case bsoncxx::type::k_codewscope:
+    {
+        bsoncxx::types::b_codewscope value = input.get_codewscope();
+        return QJsonObject{{"$code", QString::fromUtf8(value.code.data(), int(value.code.size()))},
+                           {"$scope", mongodb_document::fromBsoncxxDocument(value.scope)}};
+    }
+    case bsoncxx::type::k_int32:
+        return input.get_int32().value;
+    case bsoncxx::type::k_timestamp:
+    {
+        bsoncxx::types::b_timestamp value = input.get_timestamp();
+        return QJsonObject{{"$timestamp", QJsonObject{{"t", qint64(value.timestamp)}, {"i", qint64(value.increment)}}}};
+    }
+    case bsoncxx::type::k_int64:
+        return QJsonObject{{"$numberLong", QString::number(qint64(input.get_int64().value))}};
+    case bsoncxx::type::k_decimal128:
+        return QJsonObject{{"$numberDecimal", QString::fromStdString(input.get_decimal128().value.to_string())}};
+    case bsoncxx::type::k_maxkey:
+        return QJsonObject{{"$maxKey", 1}};
+    case bsoncxx::type::k_minkey:
+        return QJsonObject{{"$minKey", 1}};
+    default:
+        return QJsonValue(QJsonValue::Undefined);
+    }
+}
+
+/**
+ * Convert a Json document to BSON. The values are appended directly to a BSON builder, without an intermediate
+ * Json string. Objects in MongoDB extended Json format (see fromBsoncxxDocument()) are converted to their BSON type.
+ *
+ * @param input Document to be converted.
+ * @return output Converted document.
+ *
+ **/
+BsoncxxDocVal mongodb_document::toBsoncxxDocument(const QJsonObject &input)
+{
+    bsoncxx::builder::core builder(false);
+    for(QJsonObject::const_iterator it = input.constBegin(); it != input.constEnd(); ++it)
+    {
+        builder.key_owned(it.key().toStdString());
+        mongodb_document::appendToBsoncxx(builder, it.value());
+    }
+    return builder.extract_document();
+}
+
+/**
+ * Append a Json value to a BSON builder. The key (if any) has to be set before calling this function.
+ *
+ * @param builder BSON builder.
+ * @param input Value to be appended.
+ *
+ **/
+void mongodb_document::appendToBsoncxx(bsoncxx::builder::core &builder, const QJsonValue &input)
+{
+    switch(input.type())
+    {
+    case QJsonValue::Bool:
+        builder.append(input.toBool());
+        break;
+    case QJsonValue::Double:
+    {
+        // QJsonValue keeps every number as a double, so an integral double (e.g. 1.0) can't be told from an integer
+        // here and is stored as int32/int64. Unlike bsoncxx::from_json, this loses the double type of such values.
+        double value = input.toDouble();
+        if(std::floor(value) == value && value >= -2147483648.0 && value <= 2147483647.0)
+        {
+            builder.append(static_cast<std::int32_t>(value));
+        }
+        else if(std::floor(value) == value && std::fabs(value) < 9007199254740992.0)
+        {
+            builder.append(static_cast<std::int64_t>(value));
+        }
+        else
+        {
+            builder.append(value);
+        }
+        break;
+    }
+    case QJsonValue::String:
+        builder.append(input.toString().toStdString());
+        break;
+    case QJsonValue::Array:
+    {
+        builder.open_array();
+        for(const QJsonValue &value : input.toArray())
+        {
+            mongodb_document::appendToBsoncxx(builder, value);
+        }
+        builder.close_array();
+        break;
+    }
+    case QJsonValue::Object:
+    {
+        QJsonObject object = input.toObject();
+        if(!mongodb_document::appendExtendedJsonToBsoncxx(builder, object))
+        {
+            builder.open_document();
+            for(QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+            {
+                builder.key_owned(it.key().toStdString());
+                mongodb_document::appendToBsoncxx(builder, it.value());
+            }
+            builder.close_document();
+        }
+        break;
+    }
+    case QJsonValue::Null:
+    case QJsonValue::Undefined:
+    default:
+        builder.append(bsoncxx::types::b_null{});
+        break;
+    }
+}
+
+/**
+ * Append a Json object written in MongoDB extended Json format (e.g. {"$oid": "..."}) as its BSON type.
+ * Both the canonical and the relaxed formats are accepted.
+ *
+ * @param builder BSON builder.
+ * @param input Object to be appended.
+ * @return True if the object was an extended Json value and it was appended, false otherwise.
+ *
+ **/
+bool mongodb_document::appendExtendedJsonToBsoncxx(bsoncxx::builder::core &builder, const QJsonObject &input)
+{
+    if(input.isEmpty() || !input.constBegin().key().startsWith('$'))
+    {
+        return false;
+    }
+
+    if(input.size() == 1 && input.contains("$oid") && input.value("$oid").isString())
+    {
+        QString oid = input.value("$oid").toString();
+        QRegularExpression oid_format("^[0-9a-fA-F]{24}$");
+        if(oid_format.match(oid).hasMatch())
+        {
+            builder.append(bsoncxx::oid(oid.toStdString()));
+            return true;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$numberLong") && input.value("$numberLong").isString())
+    {
+        bool ok = false;
+        qint64 value = input.value("$numberLong").toString().toLongLong(&ok);
+        if(ok)
+        {
+            builder.append(static_cast<std::int64_t>(value));
+            return true;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$numberInt") && input.value("$numberInt").isString())
+    {
+        bool ok = false;
+        int value = input.value("$numberInt").toString().toInt(&ok);
+        if(ok)
+        {
+            builder.append(static_cast<std::int32_t>(value));
+            return true;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$numberDouble") && input.value("$numberDouble").isString())
+    {
+        QString text = input.value("$numberDouble").toString();
+        bool ok = true;
+        double value;
+        if(text == "NaN")
+        {
+            value = std::numeric_limits<double>::quiet_NaN();
+        }
+        else if(text == "Infinity")
+        {
+            value = std::numeric_limits<double>::infinity();
+        }
+        else if(text == "-Infinity")
+        {
+            value = -std::numeric_limits<double>::infinity();
+        }
+        else
+        {
+            value = text.toDouble(&ok);
+        }
+        if(ok)
+        {
+            builder.append(value);
+            return true;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$numberDecimal") && input.value("$numberDecimal").isString())
+    {
+        try
+        {
+            builder.append(bsoncxx::decimal128(input.value("$numberDecimal").toString().toStdString()));
+            return true;
+        }
+        catch(const bsoncxx::exception&)
+        {
+            return false;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$date"))
+    {
+        QJsonValue date = input.value("$date");
+        qint64 milliseconds = 0;
+        bool ok = false;
+
+        if(date.isObject() && date.toObject().value("$numberLong").isString())
+        {
+            milliseconds = date.toObject().value("$numberLong").toString().toLongLong(&ok);
+        }
+        else if(date.isDouble())
+        {
+            milliseconds = qint64(date.toDouble());
+            ok = true;
+        }
+        else if(date.isString())
+        {
+            QDateTime date_time = QDateTime::fromString(date.toString(), Qt::ISODate);
+            ok = date_time.isValid();
+            milliseconds = date_time.toMSecsSinceEpoch();
+        }
+
+        if(ok)
+        {
+            builder.append(bsoncxx::types::b_date(std::chrono::milliseconds(milliseconds)));
+            return true;
+        }
+    }
+    else if(input.contains("$binary") && (input.size() == 1 || (input.size() == 2 && input.contains("$type"))))
+    {
+        QString base64;
+        QString sub_type;
+        if(input.size() == 1 && input.value("$binary").isObject())
+        {
+            base64 = input.value("$binary").toObject().value("base64").toString();
+            sub_type = input.value("$binary").toObject().value("subType").toString();
+        }
+        else if(input.size() == 2)
+        {
+            // Legacy format: {"$binary": "<data>", "$type": "<hex>"}
+            base64 = input.value("$binary").toString();
+            sub_type = input.value("$type").toString();
+        }
+
+        bool ok = false;
+        int sub_type_value = sub_type.toInt(&ok, 16);
+        if(ok)
+        {
+            QByteArray data = QByteArray::fromBase64(base64.toLatin1());
+            bsoncxx::types::b_binary binary{static_cast<bsoncxx::binary_sub_type>(sub_type_value),
+                                            static_cast<std::uint32_t>(data.size()),
+                                            reinterpret_cast<const std::uint8_t*>(data.constData())};
+            builder.append(binary);
+            return true;
+        }
+    }
+    else if(input.size() == 1 && input.contains("$regularExpression") && input.value("$regularExpression").isObject())
+    {
+        QJsonObject regex = input.value("$regularExpression").toObject();
+        std::string pattern = regex.value("pattern").toString().toStdString();
+        std::string options = regex.value("options").toString().toStdString();
+        builder.append(bsoncxx::types::b_regex{pattern, options});
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$timestamp") && input.value("$timestamp").isObject())
+    {
+        QJsonObject timestamp = input.value("$timestamp").toObject();
+        bsoncxx::types::b_timestamp value{};
+        value.timestamp = static_cast<std::uint32_t>(timestamp.value("t").toDouble());
+        value.increment = static_cast<std::uint32_t>(timestamp.value("i").toDouble());
+        builder.append(value);
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$dbPointer") && input.value("$dbPointer").isObject())
+    {
+        QJsonObject pointer = input.value("$dbPointer").toObject();
+        QString oid = pointer.value("$id").toObject().value("$oid").toString();
+        QRegularExpression oid_format("^[0-9a-fA-F]{24}$");
+        if(oid_format.match(oid).hasMatch())
+        {
+            std::string collection = pointer.value("$ref").toString().toStdString();
+            bsoncxx::types::b_dbpointer value{};
+            value.collection = collection;
+            value.value = bsoncxx::oid(oid.toStdString());
+            builder.append(value);
+            return true;
+        }
+    }
+    else if(input.contains("$code") && input.value("$code").isString() && (input.size() == 1 || (input.size() == 2 && input.value("$scope").isObject())))
+    {
+        std::string code = input.value("$code").toString().toStdString();
+        if(input.size() == 1)
+        {
+            builder.append(bsoncxx::types::b_code{code});
+        }
+        else
+        {
+            BsoncxxDocVal scope = mongodb_document::toBsoncxxDocument(input.value("$scope").toObject());
+            builder.append(bsoncxx::types::b_codewscope{code, scope.view()});
+        }
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$symbol") && input.value("$symbol").isString())
+    {
+        std::string symbol = input.value("$symbol").toString().toStdString();
+        builder.append(bsoncxx::types::b_symbol{symbol});
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$minKey"))
+    {
+        builder.append(bsoncxx::types::b_minkey{});
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$maxKey"))
+    {
+        builder.append(bsoncxx::types::b_maxkey{});
+        return true;
+    }
+    else if(input.size() == 1 && input.contains("$undefined"))
+    {
+        builder.append(bsoncxx::types::b_undefined{});
+        return true;
+    }
+
+    return false;
+}
+
 /**
  * Convert documnet From BsoncxxDocView.
  *
  * @return output Converted document.
  *
  **/
-QJsonObject mongodb_document::fromBsoncxx(BsoncxxDocView input)
+QJsonObject mongodb_document::fromBsoncxx(BsoncxxDocView input) const
 {
-    std::string output = bsoncxx::to_json(input);
-    return mongodb_document::fromStdString(output);
+    return mongodb_document::fromBsoncxxDocument(input);
 }
 
 /**
- * Load document from a file in disk.
+ * Load document from a file in disk. The file is memory mapped and its UTF-8 content is parsed directly to BSON
+ * (no UTF-16 decoding and no copy of the file), the Json form is built only if it is requested.
  *
  * @param file_path Path to the file to be loaded.
  *
  **/
 void mongodb_document::loadFromDisk(QString file_path)
 {
-    //load the file and convert its contents into a QbyteArray
+    _bson.reset();
+    _bson_length = 0;
+    _document = QJsonObject();
+    _json_loaded = true;
+
     QFile file_obj(file_path);
     if(!file_obj.open(QIODevice::ReadOnly))
     {
@@ -333,20 +1055,43 @@ void mongodb_document::loadFromDisk(QString file_path)
         throw(1);
     }
 
-    QTextStream file_text(&file_obj);
-    QString output = file_text.readAll();
-    file_obj.close();
+    qint64 file_size = file_obj.size();
+    if(file_size == 0)
+    {
+        file_obj.close();
+        return;
+    }
 
-    _document = mongodb_document::fromQString(output);
+    const uchar *data = file_obj.map(0, file_size);
+    if(data == nullptr)
+    {
+        throw(1);
+    }
+
+    bsoncxx::stdx::string_view json(reinterpret_cast<const char*>(data), std::size_t(file_size));
+    try
+    {
+        mongodb_document::setBson(bsoncxx::from_json(json));
+    }
+    catch(const bsoncxx::exception&)
+    {
+        // Not a valid BSON document (e.g. a top-level array), fall back to the Json parser
+        QByteArray raw_data = QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(file_size));
+        _document = mongodb_document::fromQByteArray(raw_data);
+    }
+
+    file_obj.unmap(const_cast<uchar*>(data));
+    file_obj.close();
 }
 
 /**
- * Save document to a file in disk.
+ * Save document to a file in disk. The Json is streamed from the BSON of the document straight to the file.
  *
  * @param file_path Path to the file to be saved.
+ * @param compact If true, the Json is written without white spaces, otherwise it is indented.
  *
  **/
-void mongodb_document::saveToDisk(QString file_path)
+void mongodb_document::saveToDisk(QString file_path, bool compact) const
 {
     std::string file_path_str=file_path.toStdString();
     if(file_path_str.find_last_of(".") != std::string::npos)
@@ -367,7 +1112,11 @@ void mongodb_document::saveToDisk(QString file_path)
 
     QFile jsonFile(file_path);
     jsonFile.open(QFile::WriteOnly);
-    jsonFile.write(mongodb_document::toQByteArray());
+    {
+        mongodb_json_writer writer(&jsonFile, compact);
+        writer.writeDocument(mongodb_document::toBsoncxxDocView());
+        writer.writeRaw("\n");
+    }
     jsonFile.close();
 }
 
@@ -378,8 +1127,9 @@ void mongodb_document::saveToDisk(QString file_path)
  * @param value
  *
  **/
-void mongodb_document::insertKeyValuePair(QString &key, QJsonObject &value)
+void mongodb_document::insertKeyValuePair(const QString &key, const QJsonObject &value)
 {
+    mongodb_document::dropBson();
     _document.insert(key, value);
 }
 
@@ -390,8 +1140,9 @@ void mongodb_document::insertKeyValuePair(QString &key, QJsonObject &value)
  * @param value
  *
  **/
-void mongodb_document::insertKeyValuePair(QString key, QString value)
+void mongodb_document::insertKeyValuePair(const QString &key, const QString &value)
 {
+    mongodb_document::dropBson();
     _document.insert(key, value);
 }
 
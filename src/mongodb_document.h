@@ -2,18 +2,25 @@
 #define MONGODB_DOCUMENT_H
 
 /// \cond
+#include <QJsonArray>
 #include <QJsonObject>
+#include <QJsonValue>
 #include <QByteArray>
 #include <QJsonDocument>
 #include <QString>
 #include <QtCore/qiterator.h>
 
+#include <cstdint>
+#include <memory>
 #include <string>
 
 #ifndef Q_MOC_RUN
     #include <mongocxx/options/insert.hpp>
+    #include <bsoncxx/array/view.hpp>
+    #include <bsoncxx/builder/core.hpp>
     #include <bsoncxx/document/value.hpp>
     #include <bsoncxx/types/bson_value/value.hpp>
+    #include <bsoncxx/types/bson_value/view.hpp>
 #endif
 /// \endcond
 
@@ -21,46 +28,82 @@ typedef bsoncxx::document::view BsoncxxDocView;
 typedef bsoncxx::document::value BsoncxxDocVal;
 
 /**
- * @brief type used to store and operate with Json files in MongoDB.
+ * @brief type used to store and operate with Json files in MongoDB. Documents that come from MongoDB keep their
+ * original BSON and the Json form is only built when it is requested.
  */
 
 class mongodb_document
 {
 private:
-    QJsonObject _document;
+    // The Json form and the BSON form are built on demand, therefore they can change in const functions
+    mutable QJsonObject _document;
+    mutable bool _json_loaded = true;
+
+    // BSON of the document (null if it has not been built yet or the document was modified)
+    mutable std::shared_ptr<const std::uint8_t> _bson;
+    mutable std::size_t _bson_length = 0;
+
+    void setBson(BsoncxxDocVal &&document);
+    void storeBson(BsoncxxDocVal &&document) const;
+    BsoncxxDocView getBsonView() const;
+    void loadJson() const;
+    void dropBson();
+
+    // Conversion between BSON and Json (MongoDB extended Json for the types that Json can't represent)
+    static QJsonObject fromBsoncxxDocument(BsoncxxDocView input);
+    static QJsonArray fromBsoncxxArray(bsoncxx::array::view input);
+    static BsoncxxDocVal toBsoncxxDocument(const QJsonObject &input);
+    static void appendToBsoncxx(bsoncxx::builder::core &builder, const QJsonValue &input);
+    static bool appendExtendedJsonToBsoncxx(bsoncxx::builder::core &builder, const QJsonObject &input);
+    static qint64 estimateJsonSize(const QJsonValue &input);
+
 public:
     mongodb_document();
-    mongodb_document(QJsonObject document);
-    mongodb_document(QByteArray document);
-    mongodb_document(QJsonDocument  document);
-    mongodb_document(QString  document);
-    mongodb_document(std::string  document);
+    mongodb_document(const mongodb_document &document) = default;
+    mongodb_document(mongodb_document &&document) = default;
+    mongodb_document &operator=(const mongodb_document &document) = default;
+    mongodb_document &operator=(mongodb_document &&document) = default;
+
+    mongodb_document(const QJsonObject &document);
+    mongodb_document(QJsonObject &&document);
+    mongodb_document(const QByteArray &document);
+    mongodb_document(const QJsonDocument &document);
+    mongodb_document(const QString &document);
+    mongodb_document(const std::string &document);
     mongodb_document(BsoncxxDocView document);
+    mongodb_document(BsoncxxDocVal &&document);
+    mongodb_document(std::shared_ptr<const std::uint8_t> bson, std::size_t length);
 
-    QJsonObject getDoc();
-    QString getId();
-    bsoncxx::types::bson_value::value getIdGridfsFormat();
+    QJsonObject getDoc() const;
+    QString getId() const;
+    static QString getIdFromBsoncxx(BsoncxxDocView document);
+    static QString getIdFromBsoncxxValue(const bsoncxx::types::bson_value::view &id);
+    static QJsonValue fromBsoncxxValue(const bsoncxx::types::bson_value::view &input);
+    bool isEmpty() const;
+    bool hasBson() const;
+    qint64 getMemorySize() const;
+    bsoncxx::types::bson_value::value getIdGridfsFormat() const;
 
-    QJsonObject updateDocumentId(QString id);
-    void insertKeyValuePair(QString &key, QJsonObject &value);
-    void insertKeyValuePair(QString key, QString value);
+    QJsonObject updateDocumentId(const QString &id);
+    void insertKeyValuePair(const QString &key, const QJsonObject &value);
+    void insertKeyValuePair(const QString &key, const QString &value);
 
-    QJsonDocument  toQJsonDocument();
-    QByteArray     toQByteArray();
-    std::string    toStdString();
-    BsoncxxDocVal  toBsoncxxDocVal();
-    BsoncxxDocView toBsoncxxDocView();
-    QString        toQString();
-    QVariantMap    toQVariantMap();
+    QJsonDocument  toQJsonDocument() const;
+    QByteArray     toQByteArray() const;
+    std::string    toStdString() const;
+    BsoncxxDocVal  toBsoncxxDocVal() const;
+    BsoncxxDocView toBsoncxxDocView() const;
+    QString        toQString() const;
+    QVariantMap    toQVariantMap() const;
 
-    QJsonObject fromQJsonDocument(QJsonDocument input);
-    QJsonObject fromQByteArray(QByteArray input);
-    QJsonObject fromQString(QString input);
-    QJsonObject fromStdString(std::string input);
-    QJsonObject fromBsoncxx(BsoncxxDocView input);
+    QJsonObject fromQJsonDocument(const QJsonDocument &input) const;
+    QJsonObject fromQByteArray(const QByteArray &input) const;
+    QJsonObject fromQString(const QString &input) const;
+    QJsonObject fromStdString(const std::string &input) const;
+    QJsonObject fromBsoncxx(BsoncxxDocView input) const;
 
     void loadFromDisk(QString file_path);
-    void saveToDisk(QString file_path);
+    void saveToDisk(QString file_path, bool compact = false) const;
 
 };
 
@@ -0,0 +1,52 @@
+/// \cond
+#include <cstring>
+/// \endcond
+
+#include <mongodb_document_arena.h>
+
+/**
+ * Constructor of the class.
+ *
+ * @param block_size Size of the memory blocks. Documents bigger than a block get a block of their own.
+ *
+ **/
+mongodb_document_arena::mongodb_document_arena(std::size_t block_size):
+    _block_size(block_size)
+{
+
+}
+
+/**
+ * Copy a document into the arena.
+ *
+ * @param document Document to be copied.
+ * @return View of the copy, valid while the arena exists.
+ *
+ **/
+bsoncxx::document::view mongodb_document_arena::copy(bsoncxx::document::view document)
+{
+    std::size_t length = document.length();
+    std::uint8_t *destination;
+
+    if(length > _block_size)
+    {
+        // Big documents don't waste the rest of the current block
+        _blocks.emplace_back(new std::uint8_t[length]);
+        destination = _blocks.back().get();
+    }
+    else
+    {
+        if(length > _remaining)
+        {
+            _blocks.emplace_back(new std::uint8_t[_block_size]);
+            _current = _blocks.back().get();
+            _remaining = _block_size;
+        }
+        destination = _current;
+        _current += length;
+        _remaining -= length;
+    }
+
+    std::memcpy(destination, document.data(), length);
+    return bsoncxx::document::view(destination, length);
+}
@@ -0,0 +1,34 @@
+#ifndef MONGODB_DOCUMENT_ARENA_H
+#define MONGODB_DOCUMENT_ARENA_H
+
+/// \cond
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#ifndef Q_MOC_RUN
+    #include <bsoncxx/document/view.hpp>
+#endif
+/// \endcond
+
+/**
+ * @brief Memory block where the documents of one cursor batch are copied. The documents are freed all at once when
+ * the arena is released, which happens when the last mongodb_document pointing to it is destroyed.
+ */
+
+class mongodb_document_arena
+{
+private:
+    std::vector<std::unique_ptr<std::uint8_t[]>> _blocks;
+    std::size_t _block_size;
+    std::uint8_t *_current = nullptr;
+    std::size_t _remaining = 0;
+
+public:
+    mongodb_document_arena(std::size_t block_size = 1024 * 1024);
+
+    bsoncxx::document::view copy(bsoncxx::document::view document);
+};
+
+#endif // MONGODB_DOCUMENT_ARENA_H
@@ -0,0 +1,211 @@
+#include <mongodb_document_cache.h>
+
+/**
+ * Constructor of the class.
+ *
+ * @param max_size Maximum size of the cached documents in bytes (0 disables the cache).
+ *
+ **/
+mongodb_document_cache::mongodb_document_cache(qint64 max_size):
+    _max_size(max_size)
+{
+}
+
+/**
+ * Create the key that identifies a document in the cache.
+ *
+ * @param database Name of the database.
+ * @param collection Name of the collection.
+ * @param id Document id.
+ * @return Key of the document.
+ *
+ **/
+QString mongodb_document_cache::createKey(QString database, QString collection, QString id)
+{
+    // The unit separator character can't be part of a database or collection name
+    return database + QChar(0x1F) + collection + QChar(0x1F) + id;
+}
+
+/**
+ * Get a document from the cache. The document becomes the most recently used one.
+ *
+ * @param database Name of the database.
+ * @param collection Name of the collection.
+ * @param id Document id.
+ * @param document Container for the document.
+ * @return True if the document was found in the cache, false otherwise.
+ *
+ **/
+bool mongodb_document_cache::get(QString database, QString collection, QString id, mongodb_document *document)
+{
+    QHash<QString, std::list<cache_entry>::iterator>::iterator found = _index.find(mongodb_document_cache::createKey(database, collection, id));
+
+    if(found == _index.end())
+    {
+        return false;
+    }
+
+    // Move the entry to the front of the list
+    _entries.splice(_entries.begin(), _entries, found.value());
+    *document = found.value()->document;
+    return true;
+}
+
+/**
+ * Add a document to the cache. The least recently used documents are removed until the cache fits in its maximum size.
+ *
+ * @param database Name of the database.
+ * @param collection Name of the collection.
+ * @param id Document id.
+ * @param document Document to be cached (only its content is shared, no deep copy is made).
+ *
+ **/
+void mongodb_document_cache::insert(QString database, QString collection, QString id, mongodb_document document)
+{
+    mongodb_document_cache::remove(database, collection, id);
+
+    // The budget is charged with the memory used by the stored forms (BSON and/or Json) of the document
+    qint64 size = document.getMemorySize();
+
+    // Documents bigger than the whole cache are not stored
+    if(size > _max_size)
+    {
+        return;
+    }
+
+    QString key = mongodb_document_cache::createKey(database, collection, id);
+    _entries.push_front(cache_entry{key, std::move(document), size});
+    _index.insert(key, _entries.begin());
+    _size += size;
+
+    mongodb_document_cache::evict();
+}
+
+/**
+ * Remove a document from the cache.
+ *
+ * @param database Name of the database.
+ * @param collection Name of the collection.
+ * @param id Document id.
+ *
+ **/
+void mongodb_document_cache::remove(QString database, QString collection, QString id)
+{
+    QHash<QString, std::list<cache_entry>::iterator>::iterator found = _index.find(mongodb_document_cache::createKey(database, collection, id));
+
+    if(found != _index.end())
+    {
+        mongodb_document_cache::removeEntry(found.value());
+    }
+}
+
+/**
+ * Remove all the documents of a collection from the cache.
+ *
+ * @param database Name of the database.
+ * @param collection Name of the collection.
+ *
+ **/
+void mongodb_document_cache::removeCollection(QString database, QString collection)
+{
+    QString prefix = mongodb_document_cache::createKey(database, collection, QString());
+
+    for(std::list<cache_entry>::iterator it = _entries.begin(); it != _entries.end();)
+    {
+        std::list<cache_entry>::iterator current = it++;
+        if(current->key.startsWith(prefix))
+        {
+            mongodb_document_cache::removeEntry(current);
+        }
+    }
+}
+
+/**
+ * Remove all the documents of a database from the cache.
+ *
+ * @param database Name of the database.
+ *
+ **/
+void mongodb_document_cache::removeDatabase(QString database)
+{
+    QString prefix = database + QChar(0x1F);
+
+    for(std::list<cache_entry>::iterator it = _entries.begin(); it != _entries.end();)
+    {
+        std::list<cache_entry>::iterator current = it++;
+        if(current->key.startsWith(prefix))
+        {
+            mongodb_document_cache::removeEntry(current);
+        }
+    }
+}
+
+/**
+ * Remove all the documents from the cache.
+ *
+ **/
+void mongodb_document_cache::clear()
+{
+    _entries.clear();
+    _index.clear();
+    _size = 0;
+}
+
+/**
+ * Remove an entry from the list and the index.
+ *
+ * @param entry Entry to be removed.
+ *
+ **/
+void mongodb_document_cache::removeEntry(std::list<cache_entry>::iterator entry)
+{
+    _size -= entry->size;
+    _index.remove(entry->key);
+    _entries.erase(entry);
+}
+
+/**
+ * Remove the least recently used documents until the cache fits in its maximum size.
+ *
+ **/
+void mongodb_document_cache::evict()
+{
+    while(_size > _max_size && !_entries.empty())
+    {
+        mongodb_document_cache::removeEntry(std::prev(_entries.end()));
+    }
+}
+
+/**
+ * Set the maximum size of the cache.
+ *
+ * @param max_size Maximum size of the cached documents in bytes (0 disables the cache).
+ *
+ **/
+void mongodb_document_cache::setMaxSize(qint64 max_size)
+{
+    _max_size = max_size;
+    mongodb_document_cache::evict();
+}
+
+/**
+ * Get the maximum size of the cache.
+ *
+ * @return Maximum size in bytes.
+ *
+ **/
+qint64 mongodb_document_cache::getMaxSize()
+{
+    return _max_size;
+}
+
+/**
+ * Get the size of the documents currently cached.
+ *
+ * @return Size in bytes.
+ *
+ **/
+qint64 mongodb_document_cache::getSize()
+{
+    return _size;
+}
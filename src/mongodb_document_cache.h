@@ -0,0 +1,53 @@
+#ifndef MONGODB_DOCUMENT_CACHE_H
+#define MONGODB_DOCUMENT_CACHE_H
+
+/// \cond
+#include <QHash>
+#include <QString>
+
+#include <iterator>
+#include <list>
+/// \endcond
+
+#include <mongodb_document.h>
+
+/**
+ * @brief Least recently used cache of documents, identified by database, collection and id, with a limited size in bytes.
+ */
+
+class mongodb_document_cache
+{
+private:
+    struct cache_entry
+    {
+        QString key;
+        mongodb_document document;
+        qint64 size;
+    };
+
+    // The most recently used entries are at the front of the list
+    std::list<cache_entry> _entries;
+    QHash<QString, std::list<cache_entry>::iterator> _index;
+    qint64 _max_size;
+    qint64 _size = 0;
+
+    static QString createKey(QString database, QString collection, QString id);
+    void removeEntry(std::list<cache_entry>::iterator entry);
+    void evict();
+
+public:
+    mongodb_document_cache(qint64 max_size = 64 * 1024 * 1024);
+
+    bool get(QString database, QString collection, QString id, mongodb_document *document);
+    void insert(QString database, QString collection, QString id, mongodb_document document);
+    void remove(QString database, QString collection, QString id);
+    void removeCollection(QString database, QString collection);
+    void removeDatabase(QString database);
+    void clear();
+
+    void setMaxSize(qint64 max_size);
+    qint64 getMaxSize();
+    qint64 getSize();
+};
+
+#endif // MONGODB_DOCUMENT_CACHE_H
@@ -0,0 +1,179 @@
+/// \cond
+#include <bsoncxx/builder/concatenate.hpp>
+#include <bsoncxx/builder/stream/document.hpp>
+#include <bsoncxx/types.hpp>
+#include <mongocxx/options/find.hpp>
+/// \endcond
+
+#include <mongodb_document_cursor.h>
+
+/**
+ * Constructor of the class. Unless another sort is given, the query is sorted by _id so the position of the
+ * cursor can be resumed later on with mongodb_cursor_options::resume_after.
+ *
+ * @param collection Collection to be iterated.
+ * @param options Batch size, resume position, projection, filter, sort and limit of the cursor.
+ *
+ **/
+mongodb_document_cursor::mongodb_document_cursor(mongocxx::collection &collection, mongodb_cursor_options options):
+    _options(options),
+    _last_id(options.resume_after)
+{
+    if(_options.batch_size < 1)
+    {
+        _options.batch_size = 1;
+    }
+
+    mongocxx::options::find find_options{};
+    find_options.batch_size(_options.batch_size);
+
+    if(_options.sort)
+    {
+        find_options.sort(_options.sort->view());
+    }
+    else
+    {
+        bsoncxx::builder::stream::document sort{};
+        find_options.sort(sort << "_id" << 1 << bsoncxx::builder::stream::finalize);
+    }
+
+    if(_options.projection)
+    {
+        find_options.projection(_options.projection->view());
+    }
+
+    if(_options.limit > 0)
+    {
+        find_options.limit(_options.limit);
+    }
+
+    bsoncxx::builder::stream::document filter{};
+    if(_options.resume_after && _options.filter)
+    {
+        // Note: the server only compares _id values of the same type.
+        filter << "$and" << bsoncxx::builder::stream::open_array <<
+                  bsoncxx::types::b_document{_options.filter->view()} <<
+                  bsoncxx::builder::stream::open_document << "_id" << bsoncxx::builder::stream::open_document <<
+                  "$gt" << _options.resume_after->view() <<
+                  bsoncxx::builder::stream::close_document << bsoncxx::builder::stream::close_document <<
+                  bsoncxx::builder::stream::close_array;
+    }
+    else if(_options.resume_after)
+    {
+        // Note: the server only compares _id values of the same type.
+        filter << "_id" << bsoncxx::builder::stream::open_document <<
+                  "$gt" << _options.resume_after->view() <<
+                  bsoncxx::builder::stream::close_document;
+    }
+    else if(_options.filter)
+    {
+        filter << bsoncxx::builder::concatenate(_options.filter->view());
+    }
+
+    _cursor.reset(new mongocxx::cursor(collection.find(filter.view(), find_options)));
+}
+
+/**
+ * Walk the next batch of documents, this is the only place where the cursor is advanced and the resume
+ * position is updated.
+ *
+ * @param consume Called with each document of the batch, the view is only valid during the call.
+ * @return Number of documents in the batch (0 once the cursor is exhausted).
+ *
+ **/
+int mongodb_document_cursor::nextBatch(const std::function<void(BsoncxxDocView)> &consume)
+{
+    int size = 0;
+
+    // Calling begin() on a started cursor returns the first document that has not been consumed yet.
+    mongocxx::cursor::iterator it = _cursor->begin();
+    while(it != _cursor->end() && size < _options.batch_size)
+    {
+        bsoncxx::document::view doc = *it;
+
+        bsoncxx::document::element id = doc["_id"];
+        if(id)
+        {
+            _last_id = bsoncxx::types::bson_value::value(id.get_value());
+        }
+
+        consume(doc);
+        ++size;
+        ++it;
+    }
+
+    return size;
+}
+
+/**
+ * Get the next batch of documents. Only one batch is kept in memory at a time. The documents of the batch are
+ * copied into a single mongodb_document_arena that they share, so the batch costs a few allocations instead of
+ * several per document, and it is freed at once when the last of its documents is released.
+ *
+ * @param document_list Container for the documents of the batch (it is cleared first).
+ * @return True if the batch contains documents, false once the cursor is exhausted.
+ *
+ **/
+bool mongodb_document_cursor::next(std::vector<mongodb_document> *document_list)
+{
+    document_list->clear();
+    document_list->reserve(std::size_t(_options.batch_size));
+
+    std::shared_ptr<mongodb_document_arena> arena = std::make_shared<mongodb_document_arena>(_options.arena_block_size);
+
+    mongodb_document_cursor::nextBatch([&](BsoncxxDocView doc)
+    {
+        // The documents point to their copy in the arena and keep it alive
+        BsoncxxDocView copy = arena->copy(doc);
+        document_list->emplace_back(std::shared_ptr<const std::uint8_t>(arena, copy.data()), copy.length());
+    });
+
+    return !document_list->empty();
+}
+
+/**
+ * Get the ids of the next batch of documents. The ids are read directly from the BSON documents, so
+ * no Json conversion is done. Open the cursor with a {_id: 1} projection to transfer only the ids.
+ *
+ * @param id_list Container for the ids of the batch as text (it is cleared first).
+ * @param id_value_list Container for the ids of the batch with their BSON type, in the same order as id_list
+ * (optional, it is cleared first). Use these to select the documents again, the text form of different ids
+ * can be the same (e.g. 5 and "5").
+ * @return True if the batch contains ids, false once the cursor is exhausted.
+ *
+ **/
+bool mongodb_document_cursor::nextIdList(QStringList *id_list, std::vector<bsoncxx::types::bson_value::value> *id_value_list)
+{
+    id_list->clear();
+    id_list->reserve(_options.batch_size);
+    if(id_value_list)
+    {
+        id_value_list->clear();
+        id_value_list->reserve(std::size_t(_options.batch_size));
+    }
+
+    mongodb_document_cursor::nextBatch([&](BsoncxxDocView doc)
+    {
+        id_list->push_back(mongodb_document::getIdFromBsoncxx(doc));
+
+        if(id_value_list)
+        {
+            bsoncxx::document::element id = doc["_id"];
+            id_value_list->push_back(id ? bsoncxx::types::bson_value::value(id.get_value())
+                                        : bsoncxx::types::bson_value::value(bsoncxx::types::b_null{}));
+        }
+    });
+
+    return !id_list->isEmpty();
+}
+
+/**
+ * Get the _id of the last document returned, to be used as mongodb_cursor_options::resume_after.
+ *
+ * @return Id of the last document (empty if no document has been returned yet).
+ *
+ **/
+bsoncxx::stdx::optional<bsoncxx::types::bson_value::value> mongodb_document_cursor::getLastId()
+{
+    return _last_id;
+}
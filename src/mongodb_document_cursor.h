@@ -0,0 +1,60 @@
+#ifndef MONGODB_DOCUMENT_CURSOR_H
+#define MONGODB_DOCUMENT_CURSOR_H
+
+/// \cond
+#include <QStringList>
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifndef Q_MOC_RUN
+    #include <mongocxx/collection.hpp>
+    #include <mongocxx/cursor.hpp>
+    #include <bsoncxx/document/value.hpp>
+    #include <bsoncxx/stdx/optional.hpp>
+    #include <bsoncxx/types/bson_value/value.hpp>
+#endif
+/// \endcond
+
+#include <mongodb_document.h>
+#include <mongodb_document_arena.h>
+
+/**
+ * @brief Options used to open a mongodb_document_cursor.
+ */
+
+struct mongodb_cursor_options
+{
+    int batch_size = 1000;                                                      /**< Maximum number of documents per batch. */
+    bsoncxx::stdx::optional<bsoncxx::types::bson_value::value> resume_after;   /**< Only documents with a bigger _id are returned. */
+    bsoncxx::stdx::optional<BsoncxxDocVal> projection;                         /**< Fields to be returned by the server. */
+    bsoncxx::stdx::optional<BsoncxxDocVal> filter;                             /**< Query selecting the documents. */
+    bsoncxx::stdx::optional<BsoncxxDocVal> sort;                               /**< Sort order (by _id if not given). */
+    int limit = 0;                                                              /**< Maximum number of documents (0 means no limit). */
+    std::size_t arena_block_size = 1024 * 1024;                                 /**< Size of the memory blocks where the batches are copied. */
+};
+
+/**
+ * @brief Cursor that walks a collection in _id order and hands out its documents in batches of bounded size.
+ */
+
+class mongodb_document_cursor
+{
+private:
+    std::unique_ptr<mongocxx::cursor> _cursor;
+    mongodb_cursor_options _options;
+    bsoncxx::stdx::optional<bsoncxx::types::bson_value::value> _last_id;
+
+    int nextBatch(const std::function<void(BsoncxxDocView)> &consume);
+
+public:
+    mongodb_document_cursor(mongocxx::collection &collection, mongodb_cursor_options options);
+
+    bool next(std::vector<mongodb_document> *document_list);
+    bool nextIdList(QStringList *id_list, std::vector<bsoncxx::types::bson_value::value> *id_value_list = nullptr);
+    bsoncxx::stdx::optional<bsoncxx::types::bson_value::value> getLastId();
+};
+
+#endif // MONGODB_DOCUMENT_CURSOR_H
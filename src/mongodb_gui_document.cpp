@@ -1,10 +1,21 @@
 /// \cond
+#include <QDialog>
 #include <QFileDialog>
+#include <QHeaderView>
 #include <QInputDialog>
+#include <QLabel>
 #include <QMessageBox>
+#include <QProgressDialog>
 #include <QDebug>
 #include <QPushButton>
+#include <QTableWidget>
+#include <QTextCodec>
+#include <QThread>
+#include <QVBoxLayout>
 
+#include <algorithm>
+
+#include <mongocxx/exception/operation_exception.hpp>
 #include <mongocxx/exception/query_exception.hpp>
 /// \endcond
 
@@ -84,45 +95,204 @@ void mongodb_gui_documents::showFileContent()
     // Depending on which collection is selected, the method for reading the file is different
     if(_selected_collection == "fs.files")
     {
-        // Update GUI values:
-        // Get the json file containing the metadata:
-        mongodb_document selectedJsonDocument(manager.getDocument(ui->documentList->currentItem()->text()));
-        // Update GUI appearance:
-        ui->fileContentTextBox->setPlainText(selectedJsonDocument.toQString());
-
-        // Get the real content of the file using GridFS
-        selectedJsonDocument = manager.getDocumentGridFS(ui->documentList->currentItem()->text());
+        // Only the beginning of the file is read, more can be requested with the load more button
+        _preview_file_id = ui->documentList->currentItem()->text();
+        _preview_size = 64 * 1024;
+        showFilePreview();
     }
     else
     {
-        selectedJsonDocument = manager.getDocument(ui->documentList->currentItem()->text());
+        // Only the fields of the projection are requested (if a projection was given in the query bar)
+        mongodb_cursor_options query;
+        if(!ui->projectionLineEdit->text().trimmed().isEmpty() && manager.createQueryOptions(QString(), QString(), ui->projectionLineEdit->text(), 0, &query))
+        {
+            selectedJsonDocument = manager.getDocument(ui->documentList->currentItem()->text(), query.projection->view());
+        }
+        else
+        {
+            selectedJsonDocument = manager.getDocument(ui->documentList->currentItem()->text());
+        }
 
         // Update GUI appearance:
         ui->fileContentTextBox->setPlainText(selectedJsonDocument.toQString());
+        ui->loadMoreButton->setEnabled(false);
+    }
+
+    // restore cursor appearance
+    QGuiApplication::restoreOverrideCursor();
+}
+
+void mongodb_gui_documents::showFilePreview()
+{
+    qint64 file_length = 0;
+
+    // Get the json file containing the metadata:
+    mongodb_document metadata = manager.getDocument(_preview_file_id);
+    // Get the first bytes of the real content of the file using GridFS
+    QByteArray preview = manager.previewFileGridFS(_preview_file_id, _preview_size, &file_length);
+
+    bool binary = isBinary(preview);
+    QString content = metadata.toQString();
+    content.append(QString("\n--- %1 preview: %2 of %3 bytes ---\n").arg(binary ? "Binary" : "Text").arg(preview.size()).arg(file_length));
+    content.append(binary ? toHexView(preview) : QString::fromUtf8(preview));
+
+    bool truncated = preview.size() < file_length;
+    if(truncated && _preview_size >= mongodb_manager::MAX_PREVIEW_SIZE)
+    {
+        content.append("\n--- Preview limit reached, use Download to get the whole file ---\n");
+    }
+
+    // Update GUI appearance:
+    ui->fileContentTextBox->setPlainText(content);
+    ui->loadMoreButton->setEnabled(truncated && _preview_size < mongodb_manager::MAX_PREVIEW_SIZE);
+}
+
+bool mongodb_gui_documents::isBinary(const QByteArray &content)
+{
+    if(content.contains('\0'))
+    {
+        return true;
+    }
+
+    // Text files must be valid UTF-8 (a character cut at the end of the preview is not an error)
+    QTextCodec::ConverterState state;
+    QTextCodec::codecForName("UTF-8")->toUnicode(content.constData(), content.size(), &state);
+    return state.invalidChars > 0;
+}
+
+QString mongodb_gui_documents::toHexView(const QByteArray &content)
+{
+    // 16 bytes per line: offset, bytes in hexadecimal and printable characters
+    QString output;
+    for(int offset = 0; offset < content.size(); offset += 16)
+    {
+        QByteArray line = content.mid(offset, 16);
+        QString ascii;
+        for(char c : line)
+        {
+            ascii.append((c >= 0x20 && c < 0x7F) ? QLatin1Char(c) : QLatin1Char('.'));
+        }
+        output.append(QString("%1  %2  |%3|\n").arg(offset, 8, 16, QChar('0')).arg(QString::fromLatin1(line.toHex(' ')), -47).arg(ascii));
+    }
+    return output;
+}
+
+void mongodb_gui_documents::showSchema(QString database, QString collection, bool refresh)
+{
+    const int SAMPLE_SIZE = 1000;
+    mongodb_schema schema;
+
+    // Set cursor appearance to wait
+    QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+
+    try
+    {
+        // Another collection may have been selected since the dialog was opened
+        manager.connectToCollection(database, collection);
+        manager.getCollectionSchema(SAMPLE_SIZE, &schema, refresh);
+    }
+    catch(const mongocxx::v_noabi::operation_exception& e)
+    {
+        QGuiApplication::restoreOverrideCursor();
+        _error_message.append("SERVER ERROR: ");
+        _error_message.append(e.what());
+        errorMessage(_error_message);
+        return;
     }
 
     // restore cursor appearance
     QGuiApplication::restoreOverrideCursor();
+
+    // One row per field: path, types (with the number of documents of each type) and presence
+    QDialog *dialog = new QDialog(this);
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    dialog->setWindowTitle("Schema: " + database + "." + collection);
+    dialog->resize(700, 400);
+
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    layout->addWidget(new QLabel(QString("Sampled documents: %1").arg(schema.getDocumentCount()), dialog));
+
+    QList<mongodb_schema_field> fields = schema.getFields();
+    QTableWidget *table = new QTableWidget(fields.size(), 3, dialog);
+    table->setHorizontalHeaderLabels(QStringList() << "Field" << "Types" << "Presence");
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->verticalHeader()->setVisible(false);
+
+    for(int row = 0; row < fields.size(); row++)
+    {
+        const mongodb_schema_field &field = fields.at(row);
+
+        QStringList types;
+        for(auto it = field.types.constBegin(); it != field.types.constEnd(); ++it)
+        {
+            types.push_back(QString("%1 (%2)").arg(it.key()).arg(it.value()));
+        }
+
+        double presence = schema.getDocumentCount() > 0 ? 100.0 * double(field.count) / double(schema.getDocumentCount()) : 0.0;
+
+        table->setItem(row, 0, new QTableWidgetItem(field.path));
+        table->setItem(row, 1, new QTableWidgetItem(types.join(", ")));
+        table->setItem(row, 2, new QTableWidgetItem(QString::number(presence, 'f', 1) + " %"));
+    }
+    layout->addWidget(table);
+
+    QPushButton *refreshButton = new QPushButton("New sample", dialog);
+    layout->addWidget(refreshButton);
+    connect(refreshButton, &QPushButton::clicked, [=]()
+    {
+        dialog->close();
+        showSchema(database, collection, true);
+
+        // Go back to the collection selected in the browser
+        manager.connectToCollection(_selected_database, _selected_collection);
+    });
+
+    dialog->show();
 }
 
 void mongodb_gui_documents::updateDocumentsLists()
 {
-    std::vector<mongodb_document> document_list;
+    mongodb_cursor_options query;
     QStringList id_list;
+    std::vector<bsoncxx::types::bson_value::value> id_value_list;
 
     // set cursor appearance to wait
     QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
 
-    // Update GUI values:
-    manager.getDocumentList(&id_list,&document_list);
-
     // Update GUI appearance:
     ui->documentList->clear();
     ui->fileContentTextBox->clear();
+    ui->loadMoreButton->setEnabled(false);
+    _id_value_list.clear();
 
-    for(QString & element : id_list)
+    // The query is done by the server, only the ids of the selected documents are transferred
+    if(!manager.createQueryOptions(ui->filterLineEdit->text(), ui->sortLineEdit->text(), "{\"_id\": 1}", ui->limitSpinBox->value(), &query))
     {
-        ui->documentList->addItem(element);
+        QGuiApplication::restoreOverrideCursor();
+        _error_message.append("ERROR: The query is not valid Json.");
+        errorMessage(_error_message);
+        return;
+    }
+
+    try
+    {
+        // Add the results to the list batch by batch
+        mongodb_document_cursor cursor = manager.openDocumentCursor(query);
+        while(cursor.nextIdList(&id_list, &id_value_list))
+        {
+            ui->documentList->addItems(id_list);
+            _id_value_list.insert(_id_value_list.end(), id_value_list.begin(), id_value_list.end());
+            QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+        }
+    }
+    catch(const mongocxx::v_noabi::query_exception& e)
+    {
+        QGuiApplication::restoreOverrideCursor();
+        _error_message.append("SERVER ERROR: ");
+        _error_message.append(e.what());
+        errorMessage(_error_message);
+        return;
     }
 
     // restore cursor appearance
@@ -175,15 +345,30 @@ void mongodb_gui_documents::initializeGUI()
         // Update GUI appearance:
         ui->uploadButton->setEnabled(true);
         ui->exportButton->setEnabled(true);
+        ui->schemaButton->setEnabled(true);
         ui->addCollectionButton->setEnabled(true);
         ui->deleteCollectionButton->setEnabled(true);
         ui->addDatabaseButton->setEnabled(true);
         ui->deleteDatabaseButton->setEnabled(true);
         ui->deleteButton->setEnabled(false);
         ui->downloadButton->setEnabled(false);
+        ui->queryButton->setEnabled(true);
         updateDocumentsLists();
     });
 
+    connect(ui->queryButton, &QPushButton::clicked, [=]()
+    {
+        // Ensure that the connection is correct:
+        manager.connectToCollection(_selected_database, _selected_collection);
+
+        // Update GUI appearance:
+        ui->deleteButton->setEnabled(false);
+        ui->downloadButton->setEnabled(false);
+        updateDocumentsLists();
+    });
+
+    connect(ui->filterLineEdit, &QLineEdit::returnPressed, ui->queryButton, &QPushButton::click);
+
     connect(ui->documentList,&QListWidget::doubleClicked,[=]()
     {
         // Ensure that the connection is correct:
@@ -196,6 +381,21 @@ void mongodb_gui_documents::initializeGUI()
 
     });
 
+    connect(ui->loadMoreButton, &QPushButton::clicked, [=]()
+    {
+        // Ensure that the connection is correct:
+        manager.connectToCollection(_selected_database, _selected_collection);
+
+        // Set cursor appearance to wait
+        QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+
+        _preview_size = std::min(_preview_size * 4, mongodb_manager::MAX_PREVIEW_SIZE);
+        showFilePreview();
+
+        // restore cursor appearance
+        QGuiApplication::restoreOverrideCursor();
+    });
+
     connect(ui->downloadButton, &QPushButton::clicked, [=]()
     {
         // Ensure that the connection is correct:
@@ -203,8 +403,32 @@ void mongodb_gui_documents::initializeGUI()
 
         QString filename = QFileDialog::getSaveFileName(this,"Save as");
 
-        // Save Json into a file:
-        manager.exportDocument(ui->documentList->currentItem()->text(), filename);
+        if(_selected_collection == "fs.files" && !filename.isEmpty())
+        {
+            // GridFS files are streamed to disk, fetching their chunks in parallel and showing the progress
+            QProgressDialog progress_dialog("Downloading file...", "Cancel", 0, 1000, this);
+            progress_dialog.setWindowModality(Qt::WindowModal);
+            progress_dialog.setMinimumDuration(500);
+
+            bool downloaded = manager.downloadFileGridFSParallel(ui->documentList->currentItem()->text(), filename, QThread::idealThreadCount(), [&](qint64 written, qint64 total)
+            {
+                progress_dialog.setValue(total > 0 ? int(written * 1000 / total) : 1000);
+                QCoreApplication::processEvents();
+                return !progress_dialog.wasCanceled();
+            });
+            progress_dialog.setValue(1000);
+
+            if(!downloaded && !progress_dialog.wasCanceled())
+            {
+                _error_message.append("ERROR: The file could not be downloaded.");
+                errorMessage(_error_message);
+            }
+        }
+        else
+        {
+            // Save Json into a file:
+            manager.exportDocument(ui->documentList->currentItem()->text(), filename);
+        }
 
         // Update GUI appearance:
         ui->deleteButton->setEnabled(false);
@@ -215,10 +439,16 @@ void mongodb_gui_documents::initializeGUI()
 
     connect(ui->deleteButton, &QPushButton::clicked, [=]()
     {
-        if(ui->documentList->currentItem()!= NULL)
+        if(!ui->documentList->selectedItems().isEmpty())
         {
-            // Update GUI values:
-            manager.deleteDocument(ui->documentList->currentItem()->text());
+            // Update GUI values (all the selected documents are deleted with one command). The ids are taken
+            // with their BSON type, the text of the list can be the same for different ids (e.g. 5 and "5"):
+            std::vector<bsoncxx::types::bson_value::value> id_list;
+            for(QListWidgetItem *item : ui->documentList->selectedItems())
+            {
+                id_list.push_back(_id_value_list.at(std::size_t(ui->documentList->row(item))));
+            }
+            manager.deleteDocuments(id_list);
 
             // Update GUI appearance
             mongodb_gui_documents::updateDocumentsLists();
@@ -257,9 +487,41 @@ void mongodb_gui_documents::initializeGUI()
 
     connect(ui->exportButton, &QPushButton::clicked, [=]()
     {
-        QString filename = QFileDialog::getSaveFileName(this,"Save collection as");
-        manager.downloadCollection(filename);
+        mongodb_export_formats formats;
+        QString selected_filter;
+        QString filename = QFileDialog::getSaveFileName(this, "Save collection as", QString(), "JSON array (*.json);;NDJSON (*.ndjson *.jsonl);;BSON dump (*.bson)", &selected_filter);
 
+        if(filename.isEmpty())
+        {
+            return;
+        }
+
+        QString format = formats.JSON_ARRAY;
+        if(selected_filter.startsWith("NDJSON") || filename.endsWith(".ndjson") || filename.endsWith(".jsonl"))
+        {
+            format = formats.NDJSON;
+        }
+        else if(selected_filter.startsWith("BSON") || filename.endsWith(".bson"))
+        {
+            format = formats.BSON;
+        }
+
+        // Ensure that the connection is correct:
+        manager.connectToCollection(_selected_database, _selected_collection);
+
+        // set cursor appearance to wait
+        QGuiApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+
+        manager.downloadCollection(filename, format);
+
+        // restore cursor appearance
+        QGuiApplication::restoreOverrideCursor();
+
+    });
+
+    connect(ui->schemaButton, &QPushButton::clicked, [=]()
+    {
+        showSchema(_selected_database, _selected_collection, false);
     });
 
     connect(ui->addDatabaseButton, &QPushButton::clicked, [=]()
@@ -371,9 +633,13 @@ void mongodb_gui_documents::disableButtons()
     ui->databaseManagementControlers->setEnabled(false);
 
     ui->exportButton->setEnabled(false);
+    ui->schemaButton->setEnabled(false);
+    ui->loadMoreButton->setEnabled(false);
+    ui->queryButton->setEnabled(false);
 
     ui->documentList->clear();
     ui->fileContentTextBox->clear();
+    _id_value_list.clear();
 }
 
 void mongodb_gui_documents::configureConnection(QString user, QString password, QString database, QString port, QString host)
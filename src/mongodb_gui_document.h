@@ -30,6 +30,10 @@ public:
 private:
     void disableButtons();
     void showFileContent();
+    void showFilePreview();
+    static bool isBinary(const QByteArray &content);
+    static QString toHexView(const QByteArray &content);
+    void showSchema(QString database, QString collection, bool refresh);
     void updateCollections();
     void updateDatabases();
     void updateDocumentsLists();
@@ -45,8 +49,13 @@ private:
     QStringList _collection_list;
     QStringList _database_list;
 
+    // _id of each row of the document list with its BSON type, used to delete exactly the selected documents
+    std::vector<bsoncxx::types::bson_value::value> _id_value_list;
+
     QString _selected_database;
     QString _selected_collection;
+    QString _preview_file_id;
+    qint64 _preview_size = 0;
     QString _error_message;
 
 signals:
@@ -0,0 +1,240 @@
+/// \cond
+#include <bsoncxx/exception/exception.hpp>
+#include <bsoncxx/json.hpp>
+
+#include <cctype>
+/// \endcond
+
+#include <mongodb_json_reader.h>
+
+/**
+ * Constructor of the class.
+ *
+ * @param file_path Path to the file to be read.
+ *
+ **/
+mongodb_json_reader::mongodb_json_reader(QString file_path):
+    _file(file_path)
+{
+}
+
+/**
+ * Destructor of the class, the file is unmapped and closed.
+ *
+ **/
+mongodb_json_reader::~mongodb_json_reader()
+{
+    if(_data != nullptr)
+    {
+        _file.unmap(reinterpret_cast<uchar*>(const_cast<char*>(_data)));
+    }
+    _file.close();
+}
+
+/**
+ * Open and memory map the file.
+ *
+ * @return True if the file could be mapped, false otherwise.
+ *
+ **/
+bool mongodb_json_reader::open()
+{
+    if(!_file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    _size = _file.size();
+    _position = 0;
+
+    if(_size == 0)
+    {
+        return true;
+    }
+
+    _data = reinterpret_cast<const char*>(_file.map(0, _size));
+    if(_data == nullptr)
+    {
+        return false;
+    }
+
+    // A top-level array contains the documents as its elements
+    mongodb_json_reader::skipSeparators();
+    if(_position < _size && _data[_position] == '[')
+    {
+        _is_array = true;
+        _position++;
+    }
+
+    return true;
+}
+
+/**
+ * Check if the documents are stored in a top-level Json array.
+ *
+ * @return True for a Json array, false for NDJSON.
+ *
+ **/
+bool mongodb_json_reader::isArray()
+{
+    return _is_array;
+}
+
+/**
+ * Skip the white spaces between records (and the commas and closing bracket for arrays).
+ *
+ **/
+void mongodb_json_reader::skipSeparators()
+{
+    while(_position < _size)
+    {
+        char c = _data[_position];
+        if(std::isspace(static_cast<unsigned char>(c)) || (_is_array && (c == ',' || c == ']')))
+        {
+            _position++;
+        }
+        else
+        {
+            break;
+        }
+    }
+}
+
+/**
+ * Find the end of the record that starts at the given position. Brackets inside strings are ignored.
+ * Records that do not start with '{' are invalid and end at the next line break.
+ *
+ * @param start Position of the first character of the record.
+ * @return Position after the last character of the record.
+ *
+ **/
+qint64 mongodb_json_reader::findRecordEnd(qint64 start)
+{
+    qint64 position = start;
+
+    if(_data[start] != '{')
+    {
+        while(position < _size && _data[position] != '\n')
+        {
+            position++;
+        }
+        return position;
+    }
+
+    int depth = 0;
+    bool in_string = false;
+
+    for(; position < _size; position++)
+    {
+        char c = _data[position];
+
+        if(in_string)
+        {
+            if(c == '\\')
+            {
+                position++;
+            }
+            else if(c == '"')
+            {
+                in_string = false;
+            }
+        }
+        else if(c == '"')
+        {
+            in_string = true;
+        }
+        else if(c == '{' || c == '[')
+        {
+            depth++;
+        }
+        else if(c == '}' || c == ']')
+        {
+            depth--;
+            if(depth == 0)
+            {
+                return position + 1;
+            }
+        }
+    }
+
+    return _size;
+}
+
+/**
+ * Get the next batch of records. The records are not copied, they point to the mapped file and are valid
+ * while the reader exists.
+ *
+ * @param batch_size Maximum number of records in the batch.
+ * @param records Container for the records (it is cleared first).
+ * @return True if the batch contains records, false once the end of the file is reached.
+ *
+ **/
+bool mongodb_json_reader::nextBatch(int batch_size, std::vector<QByteArray> *records)
+{
+    records->clear();
+
+    while(int(records->size()) < batch_size)
+    {
+        mongodb_json_reader::skipSeparators();
+        if(_position >= _size)
+        {
+            break;
+        }
+
+        qint64 end = mongodb_json_reader::findRecordEnd(_position);
+        records->push_back(QByteArray::fromRawData(_data + _position, int(end - _position)));
+        _position = end;
+    }
+
+    return !records->empty();
+}
+
+/**
+ * Check if a file contains several documents, either as NDJSON (.ndjson/.jsonl) or as a top-level Json array.
+ *
+ * @param file_path Path to the file.
+ * @return True if the file contains several documents, false otherwise.
+ *
+ **/
+bool mongodb_json_reader::isMultiDocumentFile(QString file_path)
+{
+    if(file_path.endsWith(".ndjson") || file_path.endsWith(".jsonl"))
+    {
+        return true;
+    }
+
+    QFile file(file_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        return false;
+    }
+
+    // Look for the first character that is not a white space
+    char c;
+    while(file.getChar(&c))
+    {
+        if(!std::isspace(static_cast<unsigned char>(c)))
+        {
+            return c == '[';
+        }
+    }
+    return false;
+}
+
+/**
+ * Convert a record to BSON. It can be called from several threads at the same time.
+ *
+ * @param record Record to be converted, its bson field is left empty if the Json is not valid.
+ *
+ **/
+void mongodb_json_reader::parseRecord(mongodb_json_record &record)
+{
+    try
+    {
+        record.bson = bsoncxx::from_json(bsoncxx::stdx::string_view(record.json.constData(), std::size_t(record.json.size())));
+    }
+    catch(const bsoncxx::exception&)
+    {
+        record.bson = bsoncxx::stdx::nullopt;
+    }
+}
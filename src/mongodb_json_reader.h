@@ -0,0 +1,56 @@
+#ifndef MONGODB_JSON_READER_H
+#define MONGODB_JSON_READER_H
+
+/// \cond
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <vector>
+
+#ifndef Q_MOC_RUN
+    #include <bsoncxx/document/value.hpp>
+    #include <bsoncxx/stdx/optional.hpp>
+#endif
+/// \endcond
+
+/**
+ * @brief Record read from a Json file together with its BSON conversion (empty if the record is not valid Json).
+ */
+
+struct mongodb_json_record
+{
+    QByteArray json;
+    bsoncxx::stdx::optional<bsoncxx::document::value> bson;
+};
+
+/**
+ * @brief Reader that splits a file with several Json documents (NDJSON or a top-level Json array) into records.
+ * The file is memory mapped and the records point to the mapped memory, so no copy of the file is made.
+ */
+
+class mongodb_json_reader
+{
+private:
+    QFile _file;
+    const char *_data = nullptr;
+    qint64 _size = 0;
+    qint64 _position = 0;
+    bool _is_array = false;
+
+    void skipSeparators();
+    qint64 findRecordEnd(qint64 start);
+
+public:
+    mongodb_json_reader(QString file_path);
+    ~mongodb_json_reader();
+
+    bool open();
+    bool isArray();
+    bool nextBatch(int batch_size, std::vector<QByteArray> *records);
+
+    static bool isMultiDocumentFile(QString file_path);
+    static void parseRecord(mongodb_json_record &record);
+};
+
+#endif // MONGODB_JSON_READER_H
@@ -0,0 +1,389 @@
+/// \cond
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QLocale>
+
+#include <bsoncxx/types.hpp>
+
+#include <cmath>
+#include <cstring>
+/// \endcond
+
+#include <mongodb_document.h>
+#include <mongodb_json_writer.h>
+
+/**
+ * Constructor of the class.
+ *
+ * @param device Opened device where the Json is written.
+ * @param compact If true, the Json is written without white spaces, otherwise it is indented.
+ * @param buffer_size Size of the internal buffer, the data is written to the device every time the buffer is full.
+ *
+ **/
+mongodb_json_writer::mongodb_json_writer(QIODevice *device, bool compact, int buffer_size):
+    _device(device),
+    _compact(compact),
+    _buffer_size(buffer_size)
+{
+    _buffer.reserve(_buffer_size);
+}
+
+/**
+ * Destructor of the class, the remaining data of the buffer is written to the device.
+ *
+ **/
+mongodb_json_writer::~mongodb_json_writer()
+{
+    mongodb_json_writer::flush();
+}
+
+/**
+ * Write a document.
+ *
+ * @param document Document to be written.
+ *
+ **/
+void mongodb_json_writer::writeDocument(bsoncxx::document::view document)
+{
+    mongodb_json_writer::writeDocument(document, 0);
+}
+
+/**
+ * Write text without any conversion (e.g. separators between documents).
+ *
+ * @param text Text to be written.
+ *
+ **/
+void mongodb_json_writer::writeRaw(const char *text)
+{
+    mongodb_json_writer::append(text, int(std::strlen(text)));
+}
+
+/**
+ * Write the content of the buffer to the device.
+ *
+ * @return True if all the data could be written, false otherwise.
+ *
+ **/
+bool mongodb_json_writer::flush()
+{
+    if(!_buffer.isEmpty())
+    {
+        if(_device->write(_buffer) != _buffer.size())
+        {
+            _error = true;
+        }
+        _buffer.clear();
+    }
+    return !_error;
+}
+
+/**
+ * Check if there was an error writing to the device.
+ *
+ * @return True if some data could not be written, false otherwise.
+ *
+ **/
+bool mongodb_json_writer::hasError()
+{
+    return _error;
+}
+
+/**
+ * Add data to the buffer, the buffer is flushed when it is full.
+ *
+ * @param data Data to be added.
+ * @param size Size of the data.
+ *
+ **/
+void mongodb_json_writer::append(const char *data, int size)
+{
+    _buffer.append(data, size);
+    if(_buffer.size() >= _buffer_size)
+    {
+        mongodb_json_writer::flush();
+    }
+}
+
+/**
+ * Add data to the buffer, the buffer is flushed when it is full.
+ *
+ * @param data Data to be added.
+ *
+ **/
+void mongodb_json_writer::append(const QByteArray &data)
+{
+    mongodb_json_writer::append(data.constData(), data.size());
+}
+
+/**
+ * Start a new line with the given indentation (nothing is written in compact mode).
+ *
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeNewLine(int indent)
+{
+    if(_compact)
+    {
+        return;
+    }
+    _buffer.append('\n');
+    _buffer.append(QByteArray(indent * 4, ' '));
+}
+
+/**
+ * Write the key of a document field.
+ *
+ * @param key Key to be written.
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeKey(bsoncxx::stdx::string_view key, int indent)
+{
+    mongodb_json_writer::writeNewLine(indent);
+    mongodb_json_writer::writeString(key);
+    mongodb_json_writer::writeRaw(_compact ? ":" : ": ");
+}
+
+/**
+ * Write a document with the given indentation.
+ *
+ * @param document Document to be written.
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeDocument(bsoncxx::document::view document, int indent)
+{
+    if(document.empty())
+    {
+        mongodb_json_writer::writeRaw("{}");
+        return;
+    }
+
+    mongodb_json_writer::writeRaw("{");
+    bool first = true;
+    for(const bsoncxx::document::element &element : document)
+    {
+        if(!first)
+        {
+            mongodb_json_writer::writeRaw(",");
+        }
+        first = false;
+
+        mongodb_json_writer::writeKey(element.key(), indent + 1);
+        mongodb_json_writer::writeValue(element.get_value(), indent + 1);
+    }
+    mongodb_json_writer::writeNewLine(indent);
+    mongodb_json_writer::writeRaw("}");
+}
+
+/**
+ * Write an array with the given indentation.
+ *
+ * @param array Array to be written.
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeArray(bsoncxx::array::view array, int indent)
+{
+    if(array.empty())
+    {
+        mongodb_json_writer::writeRaw("[]");
+        return;
+    }
+
+    mongodb_json_writer::writeRaw("[");
+    bool first = true;
+    for(const bsoncxx::array::element &element : array)
+    {
+        if(!first)
+        {
+            mongodb_json_writer::writeRaw(",");
+        }
+        first = false;
+
+        mongodb_json_writer::writeNewLine(indent + 1);
+        mongodb_json_writer::writeValue(element.get_value(), indent + 1);
+    }
+    mongodb_json_writer::writeNewLine(indent);
+    mongodb_json_writer::writeRaw("]");
+}
+
+/**
+ * Write a Json string, escaping the characters that Json requires.
+ *
+ * @param text UTF-8 text to be written.
+ *
+ **/
+void mongodb_json_writer::writeString(bsoncxx::stdx::string_view text)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    _buffer.append('"');
+    std::size_t start = 0;
+    for(std::size_t i = 0; i < text.size(); i++)
+    {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if(c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+
+        // Copy the characters that don't need escaping in one go
+        _buffer.append(text.data() + start, int(i - start));
+        start = i + 1;
+
+        switch(c)
+        {
+        case '"':  _buffer.append("\\\""); break;
+        case '\\': _buffer.append("\\\\"); break;
+        case '\n': _buffer.append("\\n"); break;
+        case '\r': _buffer.append("\\r"); break;
+        case '\t': _buffer.append("\\t"); break;
+        case '\b': _buffer.append("\\b"); break;
+        case '\f': _buffer.append("\\f"); break;
+        default:
+        {
+            char escaped[] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xF]};
+            _buffer.append(escaped, 6);
+            break;
+        }
+        }
+    }
+    _buffer.append(text.data() + start, int(text.size() - start));
+    mongodb_json_writer::append("\"", 1);
+}
+
+/**
+ * Write a value with the given indentation. Documents, arrays and the types that Json can represent are written
+ * directly, the other types are written in the extended Json format given by mongodb_document::fromBsoncxxValue(),
+ * so the mapping of the types is defined only once.
+ *
+ * @param value Value to be written.
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeValue(const bsoncxx::types::bson_value::view &value, int indent)
+{
+    switch(value.type())
+    {
+    case bsoncxx::type::k_double:
+    {
+        double number = value.get_double().value;
+        if(!std::isfinite(number))
+        {
+            mongodb_json_writer::writeJsonValue(mongodb_document::fromBsoncxxValue(value), indent);
+            break;
+        }
+        QByteArray text = QByteArray::number(number, 'g', QLocale::FloatingPointShortest);
+        // Keep the value as a double when it is read again
+        if(!text.contains('.') && !text.contains('e'))
+        {
+            text.append(".0");
+        }
+        mongodb_json_writer::append(text);
+        break;
+    }
+    case bsoncxx::type::k_utf8:
+        mongodb_json_writer::writeString(value.get_utf8().value);
+        break;
+    case bsoncxx::type::k_document:
+        mongodb_json_writer::writeDocument(value.get_document().value, indent);
+        break;
+    case bsoncxx::type::k_array:
+        mongodb_json_writer::writeArray(value.get_array().value, indent);
+        break;
+    case bsoncxx::type::k_bool:
+        mongodb_json_writer::writeRaw(value.get_bool().value ? "true" : "false");
+        break;
+    case bsoncxx::type::k_null:
+        mongodb_json_writer::writeRaw("null");
+        break;
+    case bsoncxx::type::k_int32:
+        mongodb_json_writer::append(QByteArray::number(value.get_int32().value));
+        break;
+    default:
+        mongodb_json_writer::writeJsonValue(mongodb_document::fromBsoncxxValue(value), indent);
+        break;
+    }
+}
+
+/**
+ * Write a Json value with the given indentation, used for the extended Json form of the BSON types.
+ *
+ * @param value Value to be written.
+ * @param indent Indentation level.
+ *
+ **/
+void mongodb_json_writer::writeJsonValue(const QJsonValue &value, int indent)
+{
+    switch(value.type())
+    {
+    case QJsonValue::Object:
+    {
+        QJsonObject object = value.toObject();
+        if(object.isEmpty())
+        {
+            mongodb_json_writer::writeRaw("{}");
+            break;
+        }
+
+        mongodb_json_writer::writeRaw("{");
+        for(QJsonObject::const_iterator it = object.constBegin(); it != object.constEnd(); ++it)
+        {
+            if(it != object.constBegin())
+            {
+                mongodb_json_writer::writeRaw(",");
+            }
+
+            QByteArray key = it.key().toUtf8();
+            mongodb_json_writer::writeKey(bsoncxx::stdx::string_view(key.constData(), std::size_t(key.size())), indent + 1);
+            mongodb_json_writer::writeJsonValue(it.value(), indent + 1);
+        }
+        mongodb_json_writer::writeNewLine(indent);
+        mongodb_json_writer::writeRaw("}");
+        break;
+    }
+    case QJsonValue::Array:
+    {
+        QJsonArray array = value.toArray();
+        if(array.isEmpty())
+        {
+            mongodb_json_writer::writeRaw("[]");
+            break;
+        }
+
+        mongodb_json_writer::writeRaw("[");
+        for(int i = 0; i < array.size(); i++)
+        {
+            if(i > 0)
+            {
+                mongodb_json_writer::writeRaw(",");
+            }
+
+            mongodb_json_writer::writeNewLine(indent + 1);
+            mongodb_json_writer::writeJsonValue(array.at(i), indent + 1);
+        }
+        mongodb_json_writer::writeNewLine(indent);
+        mongodb_json_writer::writeRaw("]");
+        break;
+    }
+    case QJsonValue::String:
+    {
+        QByteArray text = value.toString().toUtf8();
+        mongodb_json_writer::writeString(bsoncxx::stdx::string_view(text.constData(), std::size_t(text.size())));
+        break;
+    }
+    case QJsonValue::Double:
+        // The numbers of the extended Json objects are integers (e.g. timestamps)
+        mongodb_json_writer::append(QByteArray::number(qint64(value.toDouble())));
+        break;
+    case QJsonValue::Bool:
+        mongodb_json_writer::writeRaw(value.toBool() ? "true" : "false");
+        break;
+    default:
+        mongodb_json_writer::writeRaw("null");
+        break;
+    }
+}
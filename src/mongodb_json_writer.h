@@ -0,0 +1,51 @@
+#ifndef MONGODB_JSON_WRITER_H
+#define MONGODB_JSON_WRITER_H
+
+/// \cond
+#include <QByteArray>
+#include <QIODevice>
+#include <QJsonValue>
+
+#ifndef Q_MOC_RUN
+    #include <bsoncxx/array/view.hpp>
+    #include <bsoncxx/document/view.hpp>
+    #include <bsoncxx/stdx/string_view.hpp>
+    #include <bsoncxx/types/bson_value/view.hpp>
+#endif
+/// \endcond
+
+/**
+ * @brief Buffered writer that streams BSON documents to a device as Json, without building them in memory first.
+ * The BSON types that Json can't represent are written in the extended Json format of mongodb_document::fromBsoncxxValue().
+ */
+
+class mongodb_json_writer
+{
+private:
+    QIODevice *_device;
+    bool _compact;
+    int _buffer_size;
+    QByteArray _buffer;
+    bool _error = false;
+
+    void writeDocument(bsoncxx::document::view document, int indent);
+    void writeArray(bsoncxx::array::view array, int indent);
+    void writeValue(const bsoncxx::types::bson_value::view &value, int indent);
+    void writeJsonValue(const QJsonValue &value, int indent);
+    void writeString(bsoncxx::stdx::string_view text);
+    void writeKey(bsoncxx::stdx::string_view key, int indent);
+    void writeNewLine(int indent);
+    void append(const char *data, int size);
+    void append(const QByteArray &data);
+
+public:
+    mongodb_json_writer(QIODevice *device, bool compact = false, int buffer_size = 64 * 1024);
+    ~mongodb_json_writer();
+
+    void writeDocument(bsoncxx::document::view document);
+    void writeRaw(const char *text);
+    bool flush();
+    bool hasError();
+};
+
+#endif // MONGODB_JSON_WRITER_H
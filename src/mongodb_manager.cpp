@@ -1,14 +1,40 @@
 ﻿/// \cond
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
+#include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
+#include <QRegularExpression>
+#include <QThread>
+#include <QtConcurrent>
+#include <QtEndian>
 
+#include <bsoncxx/builder/basic/array.hpp>
 #include <bsoncxx/builder/stream/document.hpp>
+#include <bsoncxx/exception/exception.hpp>
+#include <bsoncxx/json.hpp>
+#include <mongocxx/exception/bulk_write_exception.hpp>
+#include <mongocxx/exception/gridfs_exception.hpp>
 #include <mongocxx/exception/query_exception.hpp>
-
+#include <mongocxx/options/aggregate.hpp>
+#include <mongocxx/options/find.hpp>
+#include <mongocxx/options/gridfs/upload.hpp>
+#include <mongocxx/options/insert.hpp>
+#include <mongocxx/options/replace.hpp>
+#include <mongocxx/pipeline.hpp>
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <functional>
 /// \endcond
 
 #include <mongodb_manager.h>
+#include <mongodb_json_reader.h>
+#include <mongodb_json_writer.h>
+
+constexpr qint64 mongodb_manager::MAX_PREVIEW_SIZE;
 
 /**
  * Constructor of the class.
@@ -138,6 +164,7 @@ void mongodb_manager::connectToCollection(std::string database, std::string coll
 
 /**
  * Obtain two lists, one with the id of all the documents in the collection, and the other one with the content of the documents.
+ * For big collections use openDocumentCursor() instead, which keeps only one batch in memory.
  *
  * @param  id_list Container for the documents id.
  * @param  document_list Container for the documents.
@@ -146,52 +173,141 @@ void mongodb_manager::connectToCollection(std::string database, std::string coll
 
 void mongodb_manager::getDocumentList(QStringList *id_list, std::vector<mongodb_document> *document_list)
 {
-    /// ToDo: Divide this function in two different ones, one for getting the id's and one for getting the json files.
     // Clear the collection list
     id_list->clear();
     document_list->clear();
-    // Initialize cursor
-    mongocxx::cursor cursor = _collection_MDB.find({});
-    // Iterate over all the elements in the collection
-    for(bsoncxx::document::view doc : cursor)
+
+    std::vector<mongodb_document> batch;
+    mongodb_document_cursor cursor = mongodb_manager::openDocumentCursor();
+
+    // Iterate over all the batches in the collection
+    while(cursor.next(&batch))
+    {
+        for(mongodb_document &document : batch)
+        {
+            // Add id and document to the lists, the id is read from the BSON of the document
+            id_list->push_back(mongodb_document::getIdFromBsoncxx(document.toBsoncxxDocView()));
+            document_list->push_back(std::move(document));
+        }
+    }
+}
+
+/**
+ * Create the options of a query from its Json description. Empty fields are not used. The selection, sorting and
+ * limiting of the documents are done by the server, using the collection indexes.
+ *
+ * @param  filter Query selecting the documents, e.g. {"age": {"$gt": 30}}.
+ * @param  sort Sort order, e.g. {"age": -1}.
+ * @param  projection Fields to be returned, e.g. {"_id": 1, "name": 1}.
+ * @param  limit Maximum number of documents (0 means no limit).
+ * @param  options Container for the options of the query.
+ * @return True if all the fields are valid Json, false otherwise.
+ *
+ */
+
+bool mongodb_manager::createQueryOptions(QString filter, QString sort, QString projection, int limit, mongodb_cursor_options *options)
+{
+    try
+    {
+        if(!filter.trimmed().isEmpty())
+        {
+            options->filter = bsoncxx::from_json(filter.toStdString());
+        }
+        if(!sort.trimmed().isEmpty())
+        {
+            options->sort = bsoncxx::from_json(sort.toStdString());
+        }
+        if(!projection.trimmed().isEmpty())
+        {
+            options->projection = bsoncxx::from_json(projection.toStdString());
+        }
+    }
+    catch(const bsoncxx::exception& e)
     {
-        // Obtain id of the Json object in the collection        
-        mongodb_document document(doc);
-        QString id = document.getId();
-        // Add id to the collection list
-        id_list->push_back(id);
-        document_list->push_back(document);
+        _logger->add(_m_type.ERROR, "In function: createQueryOptions, the query is not valid Json: ", e.what());
+        return false;
     }
+
+    options->limit = limit;
+    return true;
+}
+
+/**
+ * Open a cursor over the current collection that returns the documents in batches. The memory used is bounded by
+ * the batch size, no matter how big the collection is.
+ *
+ * @param  options Batch size, resume position (last _id) and projection.
+ * @return Cursor over the collection.
+ *
+ */
+
+mongodb_document_cursor mongodb_manager::openDocumentCursor(mongodb_cursor_options options)
+{
+    mongodb_document_cursor cursor(_collection_MDB, options);
+    return cursor;
 }
 
 /**
  * Once connected to a database and collection, this function returns the document that corresponds to the input id.
+ * The lookup is resolved by the server using the _id index, so only the requested document is transferred.
+ * Recently read documents are served from the document cache (see setDocumentCacheSize()).
  *
  * @param  id Document id.
- * @return Json document.
+ * @return Json document, empty if no document with the given id exists (see mongodb_document::isEmpty()).
  *
  */
 
 mongodb_document mongodb_manager::getDocument(QString id)
 {
-    QStringList id_list;
-    std::vector<mongodb_document> document_list;
+    mongodb_document document;
 
-    // Update document list
-    mongodb_manager::getDocumentList(&id_list, &document_list);
+    // Documents read recently are served from the cache
+    if(_document_cache.get(_current_database_name, _current_collection_name, id, &document))
+    {
+        return document;
+    }
 
-    /// ToDo: Check if this can be done using runcomand:
+    bsoncxx::document::value filter = mongodb_manager::createIdFilter(id);
+    bsoncxx::stdx::optional<bsoncxx::document::value> result = _collection_MDB.find_one(filter.view());
 
-    // Iterate over all the elements in the collection
-    for(QString id_it : id_list)
+    if(result)
     {
-        if(id_it == id)
-        {
-            int index = id_list.indexOf(id_it);
-            mongodb_document doc_it = document_list.at(index);
-            return doc_it.toQByteArray();
-        }
+        document = mongodb_document(std::move(*result));
+        _document_cache.insert(_current_database_name, _current_collection_name, id, document);
+        return document;
+    }
+
+    _logger->add(_m_type.ERROR, " Json file with id ", id, " NOT found in the database.");
+
+    mongodb_document null_doc;
+    return null_doc;
+}
+
+/**
+ * Once connected to a database and collection, this function returns only the fields of the document selected by the
+ * projection. These partial documents are not cached.
+ *
+ * @param  id Document id.
+ * @param  projection Fields to be returned by the server.
+ * @return Json document, empty if no document with the given id exists.
+ *
+ */
+
+mongodb_document mongodb_manager::getDocument(QString id, BsoncxxDocView projection)
+{
+    bsoncxx::document::value filter = mongodb_manager::createIdFilter(id);
+
+    mongocxx::options::find options{};
+    options.projection(projection);
+
+    bsoncxx::stdx::optional<bsoncxx::document::value> result = _collection_MDB.find_one(filter.view(), options);
+
+    if(result)
+    {
+        mongodb_document document(std::move(*result));
+        return document;
     }
+
     _logger->add(_m_type.ERROR, " Json file with id ", id, " NOT found in the database.");
 
     mongodb_document null_doc;
@@ -221,6 +337,7 @@ bool mongodb_manager::deleteUser(QString user)
         mongodb_manager::connectToDatabase(ADMIN_DB);
         bsoncxx::document::value command = mongodb_manager::createTemplate(_actions.DELETE_USER, user);
         _database_MDB.run_command(bsoncxx::document::view_or_value(command));
+        _document_cache.removeCollection(ADMIN_DB, USERS_COLLECTION);
         _logger->add(_m_type.INFO, "Deleting user: ", user);
         return true;
     }
@@ -250,6 +367,7 @@ bool mongodb_manager::addUser(QString user, QString password)
         mongodb_manager::connectToDatabase(ADMIN_DB);
         bsoncxx::document::value command = mongodb_manager::createTemplate(_actions.ADD_USER, user, password);
         _database_MDB.run_command(bsoncxx::document::view_or_value(command));
+        _document_cache.removeCollection(ADMIN_DB, USERS_COLLECTION);
         _logger->add(_m_type.INFO, "Adding user: ", user);
         return true;
     }
@@ -287,6 +405,7 @@ bool mongodb_manager::revokeRoleFromUser(QString user, QString database, QString
         mongodb_manager::connectToDatabase(ADMIN_DB);
         bsoncxx::document::value command = mongodb_manager::createTemplate(_actions.REVOKE_ROLE, user, database, role);
         _database_MDB.run_command(bsoncxx::document::view_or_value(command));
+        _document_cache.removeCollection(ADMIN_DB, USERS_COLLECTION);
         _logger->add(_m_type.INFO, "Revoked role: ", role, " in database: ", database, " to user: ", user);
         return true;
     }
@@ -326,6 +445,7 @@ bool mongodb_manager::grantRoleToUser(QString user, QString database, QString ro
         mongodb_manager::connectToDatabase(ADMIN_DB);
         bsoncxx::document::value command = mongodb_manager::createTemplate(_actions.GRANT_ROLE, user, database, role);
         _database_MDB.run_command(bsoncxx::document::view_or_value(command));
+        _document_cache.removeCollection(ADMIN_DB, USERS_COLLECTION);
         _logger->add(_m_type.INFO, "Granted role: ", role, " in database ", database, " to user ", user);
         return true;
     }
@@ -335,7 +455,7 @@ bool mongodb_manager::grantRoleToUser(QString user, QString database, QString ro
 /**
  * Add a document to a collection specifying the id.
  *
- * @param  document File to be added to the collection.
+ * @param  document File to be added to the collection (taken by value since its id can be modified, move it in to avoid a copy).
  * @param  id Document id.
  * @return Id given to the added document.
  *
@@ -373,58 +493,73 @@ QString mongodb_manager::addDocument(mongodb_document document, QString id)
  *
  */
 
-QString mongodb_manager::addDocument(mongodb_document document)
+QString mongodb_manager::addDocument(const mongodb_document &document)
+{
+    bool inserted = false;
+    return mongodb_manager::upsertDocument(document, &inserted);
+}
+
+/**
+ * Add a document to a collection in a single round trip. If the document has an _id, it replaces the document
+ * with the same _id or inserts it when there is none (replace_one with upsert). Otherwise it is inserted and the
+ * server assigns it a new id.
+ *
+ * @param  document File to be added to the collection.
+ * @param  inserted Set to true if the document was inserted, false if an existing document was replaced.
+ * @return Id of the added document.
+ *
+ */
+
+QString mongodb_manager::upsertDocument(const mongodb_document &document, bool *inserted)
 {
-    // Check if the json_Obj has a valid MongoDB id and it's part of the collection:
     QString id = document.getId();
 
-    if(id != "NULL")
+    // The cached version of the document is no longer valid
+    _document_cache.remove(_current_database_name, _current_collection_name, id);
+
+    // Convert JSON objet to bsoncxx standard (the document owns the BSON, no copy is made)
+    bsoncxx::document::view bsoncxx_doc = document.toBsoncxxDocView();
+    bsoncxx::document::element id_element = bsoncxx_doc["_id"];
+
+    if(!id_element)
     {
-        QStringList id_list;
-        std::vector<mongodb_document> document_list;
+        _logger->add(_m_type.INFO, " The provided JSON object does not have a MongoDB _id, probably it is a new document and it has not been assigned an id yet");
 
-        // Update document list
-        mongodb_manager::getDocumentList(&id_list, &document_list);
+        // Add to collection and save the returned _id
+        bsoncxx::stdx::optional<mongocxx::result::insert_one> result = _collection_MDB.insert_one(bsoncxx_doc);
+        *inserted = true;
 
-        /// ToDo: Check if this can be done using runcomand:
-        for(QString _id_it : id_list)
+        if(result && result->inserted_id().type() == bsoncxx::type::k_oid)
         {
-            if(_id_it == id)
-            {
-                _logger->add(_m_type.INFO, "JSON file with ID: ", id, " Found in the database. Updating the document");
-                bsoncxx::document::value replacement = document.toBsoncxxDocVal();
-                bsoncxx::builder::stream::document doc{};
-                bsoncxx::document::value filt  = doc << "_id" << bsoncxx::oid(id.toStdString()) << bsoncxx::builder::stream::finalize;
-
-                // Replace the element in the collection
-                _collection_MDB.replace_one(filt.view(), replacement.view());
-                return id;
-            }
+            bsoncxx::oid oid = result->inserted_id().get_oid().value;
+            id = QString::fromStdString(oid.to_string());
+            _logger->add(_m_type.INFO, " Id of the added document : ", id);
+            return id;
         }
+        return NULL;
     }
-    else
-    {
-        _logger->add(_m_type.INFO, " The provided JSON object does not have a valid MongoDB _id format, probably it is a new document and it has not been assigned an id yet");
-    }
 
-    // If id wasn't found in the database or the JSON object, add document to the database and return the id assigned to it.
-    _logger->add(_m_type.INFO, "Json file with ID: ", id, " not found in the database. Adding it now");
+    // Filter with the _id exactly as it is stored in the document (keeps its type)
+    bsoncxx::builder::stream::document doc{};
+    bsoncxx::document::value filt = doc << "_id" << id_element.get_value() << bsoncxx::builder::stream::finalize;
+
+    mongocxx::options::replace options{};
+    options.upsert(true);
 
-    // Convert JSON objet to bsoncxx standard
-    bsoncxx::document::value bsoncxx_doc = document.toBsoncxxDocVal();
+    bsoncxx::stdx::optional<mongocxx::result::replace> result = _collection_MDB.replace_one(filt.view(), bsoncxx_doc, options);
 
-    // Add to collection and save the returned _id
-    auto result = _collection_MDB.insert_one(bsoncxx_doc.view());
+    *inserted = (result && result->upserted_id());
 
-    if (result->inserted_id().type() == bsoncxx::type::k_oid)
+    if(*inserted)
+    {
+        _logger->add(_m_type.INFO, "Json file with ID: ", id, " not found in the database. Document inserted");
+    }
+    else
     {
-        bsoncxx::oid oid = result->inserted_id().get_oid().value;
-        QString id = QString::fromStdString(oid.to_string());
-        _logger->add(_m_type.INFO, " Id of the added document : ", id);
-        return id;
+        _logger->add(_m_type.INFO, "Json file with ID: ", id, " found in the database. Document replaced");
     }
 
-    return NULL;
+    return id;
 }
 
 /**
@@ -432,11 +567,12 @@ QString mongodb_manager::addDocument(mongodb_document document)
  *
  * @param id Id of the document to be exported .
  * @param file_name Name to be given to the file.
- * @return True if the document was deleted, false otherwise.
+ * @param compact If true, the Json is written without white spaces, otherwise it is indented.
+ * @return True if the document was exported, false otherwise.
  *
  */
 
-bool mongodb_manager::exportDocument(QString id, QString file_name)
+bool mongodb_manager::exportDocument(QString id, QString file_name, bool compact)
 {
     if(id.isEmpty() || file_name.isEmpty())
     {
@@ -445,7 +581,12 @@ bool mongodb_manager::exportDocument(QString id, QString file_name)
     else
     {
         mongodb_document document = mongodb_manager::getDocument(id);
-        document.saveToDisk(file_name);
+        if(document.isEmpty())
+        {
+            _logger->add(_m_type.ERROR, "In function: exportDocument, document not found: ", id);
+            return false;
+        }
+        document.saveToDisk(file_name, compact);
         return true;
     }
     return false;
@@ -472,6 +613,8 @@ void mongodb_manager::configureConnection(std::string user, std::string password
     mongocxx::uri uri{configuration};
     // Establish connection
     _conn =  new mongocxx::client(uri);
+    _uri = configuration;
+    _pool.reset();
 
     _logger->add(_m_type.INFO, "Configuration string is: ", QString::fromStdString(configuration));
     _logger->printMessagelog(_m_type.ALL);
@@ -498,6 +641,8 @@ void mongodb_manager::configureConnection(QString user, QString password, QStrin
     mongocxx::uri uri{configuration.toStdString()};
     // Establish connection
     _conn =  new mongocxx::client(uri);
+    _uri = configuration.toStdString();
+    _pool.reset();
 }
 
 /**
@@ -580,16 +725,18 @@ void mongodb_manager::getUsersList(QStringList *user_list)
     user_list->clear();
     // Connect to the admin database and the users collection
     mongodb_manager::connectToCollection(ADMIN_DB, USERS_COLLECTION);
-    // Get the cursor to loop trough all the users in MongoDb
-    mongocxx::cursor cursor = _collection_MDB.find({});
+    // Get the cursor to loop trough all the users in MongoDb sorted by _id, only the _id is needed
+    mongocxx::options::find options{};
+    bsoncxx::builder::stream::document projection{};
+    bsoncxx::builder::stream::document sort{};
+    options.projection(projection << "_id" << 1 << bsoncxx::builder::stream::finalize);
+    options.sort(sort << "_id" << 1 << bsoncxx::builder::stream::finalize);
+    mongocxx::cursor cursor = _collection_MDB.find({}, options);
     // Add all the user names to the list
     for(bsoncxx::document::view doc : cursor)
     {
-        //Save the current user document as a QJsonObject
-        mongodb_document doc_object(doc);
-        // The id corresponds to the user
-        QString user_id = doc_object.getId();
-        user_list->push_back(user_id);
+        // The id corresponds to the user, read it directly from the BSON
+        user_list->push_back(mongodb_document::getIdFromBsoncxx(doc));
     }
 }
 
@@ -654,6 +801,12 @@ bool mongodb_manager::deleteCollection(QString database, QString collection)
     {
         mongodb_manager::connectToCollection(database, collection);
         _collection_MDB.drop();
+        _document_cache.removeCollection(database, collection);
+        _schema_cache.remove(database + QChar(0x1F) + collection);
+        if(collection == GRIDFS_FILES_COLLECTION)
+        {
+            _gridfs_hash_indexed.remove(database);
+        }
         return true;
     }
     return false;
@@ -713,6 +866,15 @@ bool mongodb_manager::deleteDatabase(QString database)
         mongodb_manager::clearDatabaseRoles(database);
         mongodb_manager::connectToDatabase(database);
         _database_MDB.drop();
+        _document_cache.removeDatabase(database);
+        _gridfs_hash_indexed.remove(database);
+        for(const QString &key : _schema_cache.keys())
+        {
+            if(key.startsWith(database + QChar(0x1F)))
+            {
+                _schema_cache.remove(key);
+            }
+        }
         _logger->add(_m_type.INFO, "Deleting database: ", database);
         return true;
     }
@@ -720,46 +882,96 @@ bool mongodb_manager::deleteDatabase(QString database)
 }
 
 /**
- * To download all the documents of a collection in a single json file.
- * The document will save all the files in the collection with the following structure:
+ * To download all the documents of a collection in a single file. A single cursor walks the collection and every
+ * document is written to the file as soon as it arrives, so the memory used does not depend on the collection size.
+ * The file will have one of the following structures:
+ *
+ * JSON_ARRAY:          NDJSON:
+ * [                    {...}
+ *  {...},              {...}
+ *  {...}               {...}
+ * ]
  *
- * {
- *  "Document0": {...},
- *  "Document1": {...},
- *        ....
- *  "DocumentN": {...}
- * }
+ * The BSON format writes the raw documents instead (see dumpCollection()).
  *
  * @param  file_name Name for the file where to save the collection.
+ * @param  format Format of the file (see mongodb_export_formats).
+ * @param  compact If true, the documents of a JSON_ARRAY are written without white spaces, otherwise they are indented.
+ *         NDJSON documents are always compact, as each one has to fit in a single line.
+ * @return True if the collection was exported, false otherwise.
  *
  */
 
-void mongodb_manager::downloadCollection(QString file_name)
+bool mongodb_manager::downloadCollection(QString file_name, QString format, bool compact)
 {
-    QStringList id_list;
-    std::vector<mongodb_document> document_list;
+    mongodb_export_formats formats;
 
-    // Update document list
-    mongodb_manager::getDocumentList(&id_list, &document_list);
+    if(file_name.isEmpty())
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadCollection, file_name is empty");
+        return false;
+    }
+
+    if(format == formats.BSON)
+    {
+        return mongodb_manager::dumpCollection(file_name);
+    }
+
+    QFile output_file(file_name);
+    if(!output_file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadCollection, failed to open: ", file_name);
+        return false;
+    }
 
-    // New document to save the collection in
-    mongodb_document collection_Object;
-    QString doc_key;
+    bool json_array = (format != formats.NDJSON);
+    qint64 document_count = 0;
+    bool written = true;
 
-    for(QString id_it : id_list)
     {
-        //Update identifier:
-        doc_key.clear();
-        doc_key.append("Document" + QString::number(id_list.indexOf(id_it)));
+        mongodb_json_writer writer(&output_file, compact || !json_array);
+
+        if(json_array)
+        {
+            writer.writeRaw("[\n");
+        }
+
+        mongocxx::options::find options{};
+        options.batch_size(1000);
+        mongocxx::cursor cursor = _collection_MDB.find({}, options);
+
+        // Write each document as it arrives
+        for(bsoncxx::document::view doc : cursor)
+        {
+            if(json_array && document_count > 0)
+            {
+                writer.writeRaw(",\n");
+            }
+
+            writer.writeDocument(doc);
+
+            if(!json_array)
+            {
+                writer.writeRaw("\n");
+            }
+            document_count++;
+        }
 
-        //Add document to the Json containing the collection:
-        mongodb_document doc_val(mongodb_manager::getDocument(id_it));
-        QJsonObject doc = doc_val.getDoc();
-        collection_Object.insertKeyValuePair(doc_key,doc);
+        if(json_array)
+        {
+            writer.writeRaw("\n]\n");
+        }
+        written = writer.flush();
     }
 
-    //Save file
-    collection_Object.saveToDisk(file_name);
+    output_file.close();
+    if(!written)
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadCollection, failed to write: ", file_name);
+        return false;
+    }
+    _logger->add(_m_type.INFO, "Collection: ", _current_collection_name, " exported to: ", file_name, " Documents: ", QString::number(document_count));
+    return true;
 }
 
 /**
@@ -811,7 +1023,6 @@ void mongodb_manager::clearDatabaseRoles(QString database)
 void mongodb_manager::getUserRolesList(QString user, QStringList *user_roles_list)
 {
     QStringList database_list;
-    mongodb_roles roles;
 
     // Connect to the admin database and the users collection.
     mongodb_manager::connectToCollection(ADMIN_DB, USERS_COLLECTION);
@@ -825,28 +1036,61 @@ void mongodb_manager::getUserRolesList(QString user, QStringList *user_roles_lis
     // Get the user data.
     mongodb_document user_data= mongodb_manager::getDocument(user);
 
-    // A user can have multiple roles. We have to save the roles of the user in an array.
-    QJsonValue roles_Value = (user_data.getDoc()).value("roles");
-    QJsonArray roles_Array = roles_Value.toArray();
+    // Read the roles directly from the BSON of the user
+    mongodb_manager::getUserRolesFromBsoncxx(user_data.toBsoncxxDocView(), database_list, user_roles_list);
+}
 
-    // Iterate over all the databases and check the current user rights.
-    for(QString database : database_list)
+/**
+ * Get the roles of a user regarding each database, reading them directly from the BSON document of the user.
+ *
+ * @param user_document BSON document of the user (from the system.users collection).
+ * @param database_list List of the databases.
+ * @param user_roles_list Container to save the roles, one per database (ROLE_NULL if the user has none).
+ *
+ */
+
+void mongodb_manager::getUserRolesFromBsoncxx(BsoncxxDocView user_document, const QStringList &database_list, QStringList *user_roles_list)
+{
+    mongodb_roles roles;
+
+    user_roles_list->clear();
+
+    // Add ROLE_NULL to the list as a sign that the user has no roles found yet.
+    for(int index = 0; index < database_list.size(); index++)
     {
-        // Add ROLE_NULL to the list as a sign that the user has no roles found yet.
         user_roles_list->push_back(roles.ROLE_NULL);
+    }
+
+    // A user can have multiple roles, each one regarding a database.
+    bsoncxx::document::element roles_element = user_document["roles"];
+    if(!roles_element || roles_element.type() != bsoncxx::type::k_array)
+    {
+        return;
+    }
 
-        // Iterate over the roles of the user and check if it has any regarding the current database.
-        for(QJsonValueRef v : roles_Array)
+    for(const bsoncxx::array::element &role_element : roles_element.get_array().value)
+    {
+        if(role_element.type() != bsoncxx::type::k_document)
         {
-            QJsonObject obj = v.toObject();
-            // In case that a role for the current database is found, update the list.
-            if(obj.value("db").toString() == database)
-            {
-                int index = database_list.indexOf(database);
-                user_roles_list->replace(index,(obj.value("role").toString()));
+            continue;
+        }
 
-                break;
-            }
+        BsoncxxDocView role_document = role_element.get_document().value;
+        bsoncxx::document::element db = role_document["db"];
+        bsoncxx::document::element role = role_document["role"];
+        if(!db || !role || db.type() != bsoncxx::type::k_utf8 || role.type() != bsoncxx::type::k_utf8)
+        {
+            continue;
+        }
+
+        bsoncxx::stdx::string_view db_name = db.get_utf8().value;
+        int index = database_list.indexOf(QString::fromUtf8(db_name.data(), int(db_name.size())));
+
+        // In case that a role for the database is found, update the list (the first one is kept).
+        if(index >= 0 && user_roles_list->at(index) == roles.ROLE_NULL)
+        {
+            bsoncxx::stdx::string_view role_name = role.get_utf8().value;
+            user_roles_list->replace(index, QString::fromUtf8(role_name.data(), int(role_name.size())));
         }
     }
 }
@@ -912,7 +1156,9 @@ int mongodb_manager::getNumberOfDatabases()
 }
 
 /**
- * Load a document file from disk and add it to the collection.
+ * Load a document file from disk and add it to the collection. Files with several documents (NDJSON or a
+ * top-level Json array) are imported with importDocuments() and .bson files with restoreCollection().
+ * Documents whose encoded BSON exceeds the 16 MiB limit of MongoDB are uploaded with GridFS, reading the file in chunks.
  *
  * @param file_path Path to the file.
  *
@@ -920,170 +1166,562 @@ int mongodb_manager::getNumberOfDatabases()
 
 void mongodb_manager::importDocument(QString file_path)
 {
-    int MAX_FILE_SIZE = 16000000 - 1;
+    // Maximum size of a BSON document accepted by MongoDB (16 MiB)
+    const qint64 MAX_BSON_SIZE = 16 * 1024 * 1024;
+
+    // Raw BSON files (mongodump format) are restored without conversion
+    if(file_path.endsWith(".bson"))
+    {
+        mongodb_manager::restoreCollection(file_path);
+        return;
+    }
+
+    // Files with several documents (NDJSON or Json array) use the bulk import
+    if(mongodb_json_reader::isMultiDocumentFile(file_path))
+    {
+        mongodb_manager::importDocuments(file_path);
+        return;
+    }
+
+    // Size heuristic: a Json text over four times the BSON limit almost never fits in 16 MiB (unless it is mostly
+    // indentation or white space), so it is uploaded straight from disk without spending the time to parse it
+    if(QFileInfo(file_path).size() > 4 * MAX_BSON_SIZE)
+    {
+        _logger->add(_m_type.INFO, " Uploading a file bigger than 64 MiB, size is: ", QString::number(QFileInfo(file_path).size()));
+        mongodb_manager::connectGridFS(_current_database_name);
+        mongodb_manager::addFileGridFS(file_path, file_path.toStdString());
+        return;
+    }
 
-    // Load size from disk
+    // Load document from disk
     mongodb_document document;
     document.loadFromDisk(file_path);
 
-    // Get the size of the file
-    QByteArray bytes = (document.toQString()).toUtf8();
-    int file_size = bytes.size();
+    // Get the exact size of the encoded document. The BSON is kept by the document, so the insert reuses it.
+    qint64 bson_size = qint64(document.toBsoncxxDocView().length());
 
-    if(file_size > MAX_FILE_SIZE)
+    // The driver adds an ObjectId _id on insert when it is missing (type, "_id" key and 12 bytes of ObjectId)
+    if(!document.toBsoncxxDocView()["_id"])
     {
-        _logger->add(_m_type.INFO, " Uploading a file bigger than 16 Mb, size is: ", QString(file_size));
+        bson_size += 1 + 4 + 12;
+    }
+
+    if(bson_size > MAX_BSON_SIZE)
+    {
+        _logger->add(_m_type.INFO, " Uploading a document bigger than 16 MiB, BSON size is: ", QString::number(bson_size));
+
+        // The document is not needed anymore, the file is read again in chunks
+        document = mongodb_document();
 
         // initialize connection to GridFS
         mongodb_manager::connectGridFS(_current_database_name);
 
         // Write file using GridFS
-        QString id = mongodb_manager::addDocumentGridFS((document.toQString()), file_path.toStdString());
+        QString id = mongodb_manager::addFileGridFS(file_path, file_path.toStdString());
     }
     else
     {
-        _logger->add(_m_type.INFO, " Uploading a file smaller than 16 Mb");
-        mongodb_document json_obj(document);
-        mongodb_manager::addDocument(json_obj);
+        _logger->add(_m_type.INFO, " Uploading a document smaller than 16 MiB, BSON size is: ", QString::number(bson_size));
+        mongodb_manager::addDocument(document);
     }
 }
 
 /**
- * Load a document file from disk and add it to the collection (with parser).
+ * Import a file with several documents (NDJSON or a top-level Json array) into the collection. The records are
+ * converted to BSON on worker threads and sent with unordered insert_many commands of batch_size documents.
  *
- * @param id Id of the document to be removed.
- * @return True if the document was deleted, false otherwise.
+ * @param file_path Path to the file.
+ * @param batch_size Number of documents sent in each insert_many.
+ * @param inserted_count Number of documents inserted (optional).
+ * @param failed_count Number of documents that could not be parsed or inserted (optional).
+ * @return True if the file could be read, false otherwise.
  *
  */
 
-bool mongodb_manager::deleteDocument(QString id)
+bool mongodb_manager::importDocuments(QString file_path, int batch_size, qint64 *inserted_count, qint64 *failed_count)
 {
-    QStringList id_list;
-    std::vector<mongodb_document> document_list;
+    qint64 inserted = 0;
+    qint64 failed = 0;
 
-    // Update document list
-    mongodb_manager::getDocumentList(&id_list, &document_list);
-
-    // Depending on which collection is selected, the method for deleting the file is different
-    if(_current_collection_name == "fs.files")
+    mongodb_json_reader reader(file_path);
+    if(!reader.open())
     {
-        // Initialize connection to GridFS
-        connectGridFS(_current_database_name);
-        mongodb_document doc;
-        doc.updateDocumentId(id);
-
-        bsoncxx::types::bson_value::value id_GridFS = doc.getIdGridfsFormat();
-        _gridfs_bucket.delete_file(id_GridFS);
-        return true;
+        _logger->add(_m_type.ERROR, "In function: importDocuments, failed to open: ", file_path);
+        return false;
     }
-    else if(_current_collection_name == "fs.chunks")
+
+    if(batch_size < 1)
     {
-        _logger->add(_m_type.INFO, " Can't delete elements from this database");
-        return false;
+        batch_size = 1;
     }
-    else
+
+    std::vector<QByteArray> json_batch;
+    std::vector<mongodb_json_record> records;
+    std::vector<bsoncxx::document::view> documents;
+
+    while(reader.nextBatch(batch_size, &json_batch))
     {
-        // Iterate over all the elements in the collection
-        for(QString id_it : id_list)
+        // Parse the batch on worker threads
+        records.clear();
+        records.resize(json_batch.size());
+        for(std::size_t i = 0; i < json_batch.size(); i++)
         {
-            if(id_it == id)
-            {
-                _logger->add(_m_type.INFO, " Json file with id ", id, " found in the database");
-                bsoncxx::builder::stream::document doc{};
-                bsoncxx::document::value filt  = doc << "_id" << bsoncxx::oid(id.toStdString()) << bsoncxx::builder::stream::finalize;
+            records[i].json = json_batch[i];
+        }
+        QtConcurrent::blockingMap(records, &mongodb_json_reader::parseRecord);
 
-                _collection_MDB.delete_one(filt.view());
-                return true;
+        documents.clear();
+        for(mongodb_json_record &record : records)
+        {
+            if(record.bson)
+            {
+                documents.push_back(record.bson->view());
+            }
+            else
+            {
+                failed++;
             }
         }
+
+        mongodb_manager::insertDocumentBatch(documents, &inserted, &failed);
     }
 
-    _logger->add(_m_type.ERROR, " Json file with id ", id, " NOT found in the database. ");
-    return false;
+    _logger->add(_m_type.INFO, "Imported file: ", file_path, " Inserted documents: ", QString::number(inserted), " Failed documents: ", QString::number(failed));
+
+    if(inserted_count != nullptr)
+    {
+        *inserted_count = inserted;
+    }
+    if(failed_count != nullptr)
+    {
+        *failed_count = failed;
+    }
+    return true;
 }
 
 /**
- * Get a table with the roles for each user regarding all the databases.
+ * Insert a batch of documents with one unordered insert_many. Invalid documents (e.g. duplicated ids) do not stop
+ * the insertion of the rest of the batch.
  *
- * @param roles_table Container for the table info.
+ * @param documents Documents to be inserted.
+ * @param inserted_count Incremented with the number of inserted documents.
+ * @param failed_count Incremented with the number of documents that could not be inserted.
  *
  */
 
-void mongodb_manager::getRolesTable(std::vector<QStringList> *roles_table)
+void mongodb_manager::insertDocumentBatch(std::vector<bsoncxx::document::view> &documents, qint64 *inserted_count, qint64 *failed_count)
 {
-    QStringList database_list;
-    QStringList users_list;
-    QStringList user_roles_list;
-
-    // Empty the container for the table
-    roles_table->clear();
-
-    // Get a vector with a list of the database names
-    mongodb_manager::getDatabaseList(&database_list);
-    mongodb_manager::getUsersList(&users_list);
+    if(documents.empty())
+    {
+        return;
+    }
 
-    // Connect to the admin database, use the collection that contains the list of the users
-    mongodb_manager::connectToCollection(ADMIN_DB, USERS_COLLECTION);
+    mongocxx::options::insert options{};
+    options.ordered(false);
 
-    // Iterate over all the users
-    for(QString user : users_list)
+    try
     {
-        // Get user roles
-        mongodb_manager::getUserRolesList(user, &user_roles_list);
-
-        // Don't show the admin user that is running the program
-        if(user.remove(ADMIN_DB_EXTEND) != _user)
+        bsoncxx::stdx::optional<mongocxx::result::insert_many> result = _collection_MDB.insert_many(documents, options);
+        qint64 batch_inserted = result ? qint64(result->inserted_count()) : 0;
+        *inserted_count += batch_inserted;
+        *failed_count += qint64(documents.size()) - batch_inserted;
+    }
+    catch(const mongocxx::bulk_write_exception& e)
+    {
+        // With unordered inserts the valid documents of the batch are still inserted
+        qint64 batch_inserted = 0;
+        if(e.raw_server_error())
         {
-            // Add row with the user information
-            roles_table->push_back(user_roles_list);
+            bsoncxx::document::element n_inserted = e.raw_server_error()->view()["nInserted"];
+            if(n_inserted && n_inserted.type() == bsoncxx::type::k_int32)
+            {
+                batch_inserted = n_inserted.get_int32().value;
+            }
         }
+        *inserted_count += batch_inserted;
+        *failed_count += qint64(documents.size()) - batch_inserted;
+        _logger->add(_m_type.ERROR, "In function: insertDocumentBatch, ", e.what());
     }
 }
 
 /**
- * Set a custom mongodb_logger different than the one created by default, this is used
- * when the manager is created by other classes and we want both to use the same logger.
+ * Save all the documents of the collection to a .bson file. The raw BSON of each document is written as it comes
+ * from the cursor, without any conversion, so the file has the same format as the ones created by mongodump.
  *
- * @param custom_logger
+ * @param file_name Name for the file where to save the collection.
+ * @return True if the collection was saved, false otherwise.
  *
  */
 
-void mongodb_manager::setCustomLogger(mongodb_logger *custom_logger)
+bool mongodb_manager::dumpCollection(QString file_name)
 {
-    if(_logger_custom == false)
+    QFile output_file(file_name);
+    if(file_name.isEmpty() || !output_file.open(QFile::WriteOnly | QFile::Truncate))
     {
-        delete _logger;
-        _logger_custom = true;
+        _logger->add(_m_type.ERROR, "In function: dumpCollection, failed to open: ", file_name);
+        return false;
     }
 
-    if(_logger != custom_logger)
+    qint64 document_count = 0;
+
+    mongocxx::options::find options{};
+    options.batch_size(1000);
+    mongocxx::cursor cursor = _collection_MDB.find({}, options);
+
+    bool written = true;
+    for(bsoncxx::document::view doc : cursor)
     {
-        _logger = custom_logger;
+        if(output_file.write(reinterpret_cast<const char*>(doc.data()), qint64(doc.length())) != qint64(doc.length()))
+        {
+            written = false;
+            break;
+        }
+        document_count++;
     }
-}
-
-/**
- * Print the log with all the messages generated by the manager functions.
- */
 
-void mongodb_manager::printlog()
-{
-    _logger->printMessagelog(_m_type.ALL);
+    // The data still in the buffer of the file can also fail to be written
+    written = output_file.flush() && written;
+    output_file.close();
+    if(!written)
+    {
+        // A truncated dump can't be told apart from a complete one, don't leave it on disk
+        output_file.remove();
+        _logger->add(_m_type.ERROR, "In function: dumpCollection, failed to write: ", file_name);
+        return false;
+    }
+    _logger->add(_m_type.INFO, "Collection: ", _current_collection_name, " dumped to: ", file_name, " Documents: ", QString::number(document_count));
+    return true;
 }
 
 /**
- * Create the command required for using functio: runcomand(). Depending on the type of command, the input parameters will change.
+ * Insert all the documents of a .bson file (e.g. created by dumpCollection() or mongodump) into the collection.
+ * The file is memory mapped and the documents are sent, without any conversion, in unordered insert_many batches.
  *
- * @param option
- * @param field1
- * @param field2
- * @param field3
+ * @param file_path Path to the file.
+ * @param batch_size Number of documents sent in each insert_many.
+ * @param inserted_count Number of documents inserted (optional).
+ * @param failed_count Number of documents that could not be inserted (optional).
+ * @return True if the whole file could be read, false otherwise.
  *
  */
 
-bsoncxx::document::value mongodb_manager::createTemplate(QString option,QString field1 ,QString field2,QString field3)
+bool mongodb_manager::restoreCollection(QString file_path, int batch_size, qint64 *inserted_count, qint64 *failed_count)
 {
-    mongodb_actions actions;
+    qint64 inserted = 0;
+    qint64 failed = 0;
+    bool valid_file = true;
+
+    QFile input_file(file_path);
+    if(!input_file.open(QIODevice::ReadOnly))
+    {
+        _logger->add(_m_type.ERROR, "In function: restoreCollection, failed to open: ", file_path);
+        return false;
+    }
+
+    qint64 file_size = input_file.size();
+    const uchar *data = file_size > 0 ? input_file.map(0, file_size) : nullptr;
+    if(file_size > 0 && data == nullptr)
+    {
+        _logger->add(_m_type.ERROR, "In function: restoreCollection, failed to map: ", file_path);
+        return false;
+    }
+
+    if(batch_size < 1)
+    {
+        batch_size = 1;
+    }
+
+    std::vector<bsoncxx::document::view> documents;
+    qint64 position = 0;
+
+    while(position < file_size)
+    {
+        // Each document starts with its total length as a little endian int32
+        if(file_size - position < 5)
+        {
+            valid_file = false;
+            break;
+        }
+        qint32 length = qFromLittleEndian<qint32>(data + position);
+        if(length < 5 || length > file_size - position)
+        {
+            valid_file = false;
+            break;
+        }
+
+        documents.push_back(bsoncxx::document::view(data + position, std::size_t(length)));
+        position += length;
+
+        if(int(documents.size()) == batch_size)
+        {
+            mongodb_manager::insertDocumentBatch(documents, &inserted, &failed);
+            documents.clear();
+        }
+    }
+    mongodb_manager::insertDocumentBatch(documents, &inserted, &failed);
+
+    if(data != nullptr)
+    {
+        input_file.unmap(const_cast<uchar*>(data));
+    }
+    input_file.close();
+
+    if(!valid_file)
+    {
+        _logger->add(_m_type.ERROR, "In function: restoreCollection, corrupted document at byte ", QString::number(position), " of ", file_path);
+    }
+    _logger->add(_m_type.INFO, "Restored file: ", file_path, " Inserted documents: ", QString::number(inserted), " Failed documents: ", QString::number(failed));
+
+    if(inserted_count != nullptr)
+    {
+        *inserted_count = inserted;
+    }
+    if(failed_count != nullptr)
+    {
+        *failed_count = failed;
+    }
+    return valid_file;
+}
+
+/**
+ * Infer the schema of the current collection from a random sample of its documents. The sample is taken by the
+ * server ($sample), so the collection is not scanned, and the documents are analyzed on worker threads. The result
+ * is cached per collection until refresh is requested or the collection is deleted.
+ *
+ * @param sample_size Number of documents of the sample.
+ * @param schema Container for the schema.
+ * @param refresh If true, a new sample is taken even if the schema is cached.
+ * @return True if the schema could be obtained, false otherwise.
+ *
+ */
+
+bool mongodb_manager::getCollectionSchema(int sample_size, mongodb_schema *schema, bool refresh)
+{
+    QString key = _current_database_name + QChar(0x1F) + _current_collection_name;
+
+    if(!refresh && _schema_cache.contains(key))
+    {
+        *schema = _schema_cache.value(key);
+        return true;
+    }
+
+    if(sample_size < 1)
+    {
+        _logger->add(_m_type.ERROR, "In function: getCollectionSchema, the sample size must be positive");
+        return false;
+    }
+
+    mongocxx::pipeline pipeline{};
+    pipeline.sample(sample_size);
+
+    mongocxx::options::aggregate options{};
+    options.batch_size(1000);
+    mongocxx::cursor cursor = _collection_MDB.aggregate(pipeline, options);
+
+    // The sampled documents share an arena, as in mongodb_document_cursor
+    std::vector<mongodb_document> documents;
+    documents.reserve(std::size_t(sample_size));
+    std::shared_ptr<mongodb_document_arena> arena = std::make_shared<mongodb_document_arena>();
+    for(bsoncxx::document::view doc : cursor)
+    {
+        BsoncxxDocView copy = arena->copy(doc);
+        documents.emplace_back(std::shared_ptr<const std::uint8_t>(arena, copy.data()), copy.length());
+    }
+
+    // Analyze the documents on worker threads and merge the results
+    *schema = QtConcurrent::blockingMappedReduced(documents, &mongodb_schema::fromDocument, &mongodb_schema::merge, QtConcurrent::UnorderedReduce);
+
+    _schema_cache.insert(key, *schema);
+    _logger->add(_m_type.INFO, "Schema of collection: ", _current_collection_name, " inferred from: ", QString::number(schema->getDocumentCount()), " documents");
+    return true;
+}
+
+/**
+ * Delete a document from the collection.
+ *
+ * @param id _id of the document to be removed, with its BSON type (e.g. as listed by mongodb_document_cursor::nextIdList()).
+ * @return True if the document was deleted, false otherwise.
+ *
+ */
+
+bool mongodb_manager::deleteDocument(const bsoncxx::types::bson_value::value &id)
+{
+    return mongodb_manager::deleteDocuments(std::vector<bsoncxx::types::bson_value::value>{id}) > 0;
+}
+
+/**
+ * Delete a list of documents from the collection with a single delete_many command. The ids are matched with
+ * their BSON type, so only the listed documents are removed (e.g. deleting the id 5 doesn't delete the id "5").
+ *
+ * @param id_list _id of the documents to be removed, with their BSON type (see mongodb_document_cursor::nextIdList()).
+ * @return Number of deleted documents.
+ *
+ */
+
+int mongodb_manager::deleteDocuments(const std::vector<bsoncxx::types::bson_value::value> &id_list)
+{
+    if(id_list.empty())
+    {
+        return 0;
+    }
+
+    // Depending on which collection is selected, the method for deleting the file is different
+    if(_current_collection_name == GRIDFS_FILES_COLLECTION)
+    {
+        // Initialize connection to GridFS
+        connectGridFS(_current_database_name);
+
+        // GridFS removes the metadata and the chunks of each file
+        int deleted_count = 0;
+        for(const bsoncxx::types::bson_value::value &id_GridFS : id_list)
+        {
+            QString id = mongodb_document::getIdFromBsoncxxValue(id_GridFS.view());
+
+            // Remove the cached metadata of the file
+            _document_cache.remove(_current_database_name, GRIDFS_FILES_COLLECTION, id);
+
+            // Only the files that were actually removed are counted
+            try
+            {
+                _gridfs_bucket.delete_file(id_GridFS.view());
+                deleted_count++;
+            }
+            catch(const mongocxx::gridfs_exception &e)
+            {
+                _logger->add(_m_type.ERROR, "In function: deleteDocuments, GridFS file: ", id, " could not be deleted: ", e.what());
+            }
+        }
+        _logger->add(_m_type.INFO, " Deleted GridFS files: ", QString::number(deleted_count));
+        return deleted_count;
+    }
+    else if(_current_collection_name == GRIDFS_CHUNKS_COLLECTION)
+    {
+        _logger->add(_m_type.INFO, " Can't delete elements from this database");
+        return 0;
+    }
+
+    for(const bsoncxx::types::bson_value::value &id : id_list)
+    {
+        _document_cache.remove(_current_database_name, _current_collection_name, mongodb_document::getIdFromBsoncxxValue(id.view()));
+    }
+
+    bsoncxx::document::value filt = mongodb_manager::createIdFilter(id_list);
+    bsoncxx::stdx::optional<mongocxx::result::delete_result> result = _collection_MDB.delete_many(filt.view());
+
+    int deleted_count = result ? int(result->deleted_count()) : 0;
+    if(deleted_count == 0)
+    {
+        _logger->add(_m_type.ERROR, " Documents NOT found in the database. Requested: ", QString::number(id_list.size()));
+        return 0;
+    }
+
+    _logger->add(_m_type.INFO, " Deleted documents: ", QString::number(deleted_count), " of ", QString::number(id_list.size()), " requested");
+    return deleted_count;
+}
+
+/**
+ * Get a table with the roles for each user regarding all the databases.
+ *
+ * @param roles_table Container for the table info.
+ *
+ */
+
+void mongodb_manager::getRolesTable(std::vector<QStringList> *roles_table)
+{
+    QStringList database_list;
+    QStringList user_roles_list;
+
+    // Empty the container for the table
+    roles_table->clear();
+
+    // Get a vector with a list of the database names
+    mongodb_manager::getDatabaseList(&database_list);
+
+    // Connect to the admin database, use the collection that contains the list of the users
+    mongodb_manager::connectToCollection(ADMIN_DB, USERS_COLLECTION);
+
+    // Iterate over all the users sorted by _id like getUsersList(), so the rows line up with its entries,
+    // only the id and the roles are needed
+    mongocxx::options::find options{};
+    bsoncxx::builder::stream::document projection{};
+    bsoncxx::builder::stream::document sort{};
+    options.projection(projection << "_id" << 1 << "roles" << 1 << bsoncxx::builder::stream::finalize);
+    options.sort(sort << "_id" << 1 << bsoncxx::builder::stream::finalize);
+    mongocxx::cursor cursor = _collection_MDB.find({}, options);
+
+    for(bsoncxx::document::view doc : cursor)
+    {
+        QString user = mongodb_document::getIdFromBsoncxx(doc);
+
+        // Get user roles
+        mongodb_manager::getUserRolesFromBsoncxx(doc, database_list, &user_roles_list);
+
+        // Don't show the admin user that is running the program
+        if(user.remove(ADMIN_DB_EXTEND) != _user)
+        {
+            // Add row with the user information
+            roles_table->push_back(user_roles_list);
+        }
+    }
+}
+
+/**
+ * Set a custom mongodb_logger different than the one created by default, this is used
+ * when the manager is created by other classes and we want both to use the same logger.
+ *
+ * @param custom_logger
+ *
+ */
+
+void mongodb_manager::setCustomLogger(mongodb_logger *custom_logger)
+{
+    if(_logger_custom == false)
+    {
+        delete _logger;
+        _logger_custom = true;
+    }
+
+    if(_logger != custom_logger)
+    {
+        _logger = custom_logger;
+    }
+}
+
+/**
+ * Set the maximum size of the document cache. The cache keeps the documents read with getDocument(); it is
+ * updated automatically when documents, collections or databases are modified.
+ *
+ * @param max_size Maximum size in bytes (0 disables the cache).
+ *
+ */
+
+void mongodb_manager::setDocumentCacheSize(qint64 max_size)
+{
+    _document_cache.setMaxSize(max_size);
+}
+
+/**
+ * Print the log with all the messages generated by the manager functions.
+ */
+
+void mongodb_manager::printlog()
+{
+    _logger->printMessagelog(_m_type.ALL);
+}
+
+/**
+ * Create the command required for using functio: runcomand(). Depending on the type of command, the input parameters will change.
+ *
+ * @param option
+ * @param field1
+ * @param field2
+ * @param field3
+ *
+ */
+
+bsoncxx::document::value mongodb_manager::createTemplate(QString option,QString field1 ,QString field2,QString field3)
+{
+    mongodb_actions actions;
 
     bsoncxx::builder::stream::document doc{};
 
@@ -1125,6 +1763,95 @@ bsoncxx::document::value mongodb_manager::createTemplate(QString option,QString
     }
 }
 
+/**
+ * Create a filter that matches a document by its _id. Since the id is only known as text, the filter accepts
+ * every type the text can represent (ObjectId, string and number) with an $in over the _id index. It can match
+ * several documents (e.g. 5 and "5"), so it is only used to read documents, deletions use the typed ids
+ * (see createIdFilter(const std::vector<bsoncxx::types::bson_value::value>&)).
+ *
+ * @param id Document id.
+ * @return Filter to be used in find operations.
+ *
+ */
+
+bsoncxx::document::value mongodb_manager::createIdFilter(QString id)
+{
+    return mongodb_manager::createIdFilter(QStringList() << id);
+}
+
+/**
+ * Create a filter that matches all the documents whose _id is in the list (see createIdFilter(QString)).
+ *
+ * @param id_list Documents id.
+ * @return Filter to be used in find operations.
+ *
+ */
+
+bsoncxx::document::value mongodb_manager::createIdFilter(QStringList id_list)
+{
+    bsoncxx::builder::basic::array candidates{};
+    QRegularExpression oid_format("^[0-9a-fA-F]{24}$");
+
+    for(QString id : id_list)
+    {
+        // ObjectId written as a 24 characters hexadecimal string
+        if(oid_format.match(id).hasMatch())
+        {
+            candidates.append(bsoncxx::oid(id.toStdString()));
+        }
+
+        // Numeric ids (the server compares int32, int64 and double values by their numeric value)
+        bool is_integer = false;
+        bool is_double = false;
+        qint64 id_integer = id.toLongLong(&is_integer);
+        double id_double = id.toDouble(&is_double);
+        if(is_integer)
+        {
+            candidates.append(static_cast<std::int64_t>(id_integer));
+        }
+        else if(is_double)
+        {
+            candidates.append(id_double);
+        }
+
+        // Ids stored as plain strings
+        candidates.append(id.toStdString());
+    }
+
+    bsoncxx::builder::stream::document doc{};
+    bsoncxx::document::value filter = doc << "_id" << bsoncxx::builder::stream::open_document <<
+                                             "$in" << bsoncxx::types::b_array{candidates.view()} <<
+                                             bsoncxx::builder::stream::close_document <<
+                                             bsoncxx::builder::stream::finalize;
+    return filter;
+}
+
+/**
+ * Create a filter that matches exactly the documents whose _id is in the list. Unlike createIdFilter(QStringList),
+ * the ids keep their BSON type, so an id only matches itself (the _id index doesn't allow two numeric ids with the
+ * same value, e.g. 5 and 5.0, so the numeric comparison of the server can't select another document).
+ *
+ * @param id_list Documents id, with their BSON type.
+ * @return Filter to be used in find/replace/delete operations.
+ *
+ */
+
+bsoncxx::document::value mongodb_manager::createIdFilter(const std::vector<bsoncxx::types::bson_value::value> &id_list)
+{
+    bsoncxx::builder::basic::array ids{};
+    for(const bsoncxx::types::bson_value::value &id : id_list)
+    {
+        ids.append(id.view());
+    }
+
+    bsoncxx::builder::stream::document doc{};
+    bsoncxx::document::value filter = doc << "_id" << bsoncxx::builder::stream::open_document <<
+                                             "$in" << bsoncxx::types::b_array{ids.view()} <<
+                                             bsoncxx::builder::stream::close_document <<
+                                             bsoncxx::builder::stream::finalize;
+    return filter;
+}
+
 /**
  * Load a .json file containing the credentials required to log into MongoDB. If the credentials file doesn't have all the required fields, the returned map will be empty.
  *
@@ -1256,80 +1983,392 @@ bool mongodb_manager::verifyRole(QString role)
 
 
 /**
- * For files bigger than 16 Mb, use the GridFS library to upload them to the database. GridFS by default uses two collections fs.files
- * and fs.chunks to store the file's metadata and the chunks. Each chunk is identified by its unique _id ObjectId field. The fs.files
- * serves as a parent document. The files_id field in the fs.chunks document links the chunk to its parent.
+ * Upload a file from disk with GridFS. The file is read in chunks of chunk_size bytes and each chunk is written to
+ * the uploader as it is read, so the memory used doesn't depend on the size of the file. The SHA-256 of the file is
+ * saved in the metadata (metadata.sha256), and if a file with the same hash and size is already stored, the upload
+ * is skipped and the id of that file is returned.
  *
- * @param  document File to be uploaded to the database.
+ * @param  file_path Path to the file to be uploaded.
  * @param  file_name Name given to the file in the fs.file collection.
- * @return Id of the added document.
+ * @param  chunk_size Size of the GridFS chunks, also used as the size of the reads.
+ * @return Id of the added (or already stored) file, empty if it could not be uploaded.
  *
  */
 
-QString mongodb_manager::addDocumentGridFS(QString document, std::string file_name)
+QString mongodb_manager::addFileGridFS(QString file_path, std::string file_name, int chunk_size)
 {
-    // Store the content of the QString in a std::vector (format needed by GridFS methods)
-    std::string document_stdstring = document.toStdString();
-    std::string::iterator begining = document_stdstring.begin();
-    std::string::iterator ending = document_stdstring.end();
-    std::vector<uint8_t> json_vector(begining, ending);
-    uint8_t *json_vector_ptr = &json_vector[0];
+    QFile file(file_path);
+    if(chunk_size < 1 || !file.open(QFile::ReadOnly))
+    {
+        _logger->add(_m_type.ERROR, "In function: addFileGridFS, failed to open: ", file_path);
+        return QString();
+    }
 
-    // Iniitalize the GridFS uploader method
-    mongocxx::gridfs::uploader uploader = _gridfs_bucket.open_upload_stream(file_name); //Using the same name of the file
+    // Size and modification time of the hashed content, used to detect changes during the upload
+    qint64 hashed_size = file.size();
+    QDateTime hashed_modified = QFileInfo(file_path).lastModified();
 
-    // Upload the json_vector to the database and close uploader once it's done
-    uploader.write(json_vector_ptr, json_vector.size() );
-    mongocxx::result::gridfs::upload result = uploader.close();
+    // First pass: hash the file (read in blocks by QCryptographicHash)
+    QCryptographicHash file_hash(QCryptographicHash::Sha256);
+    if(!file_hash.addData(&file))
+    {
+        _logger->add(_m_type.ERROR, "In function: addFileGridFS, failed to read: ", file_path);
+        return QString();
+    }
+    QString sha256 = QString::fromLatin1(file_hash.result().toHex());
 
-    // Get the id of the written file
-    bsoncxx::types::bson_value::view bson_id = result.id(); // ToDo: Check possible conflict between view and value
+    // Don't upload the same content twice
+    QString existing_id = mongodb_manager::findFileGridFS(sha256, hashed_size);
+    if(!existing_id.isEmpty())
+    {
+        _logger->add(_m_type.INFO, "File: ", file_path, " already stored with GridFS, id: ", existing_id);
+        return existing_id;
+    }
+
+    // Second pass: upload the file, the hash is saved in the metadata
+    file.seek(0);
+    mongocxx::options::gridfs::upload options{};
+    options.chunk_size_bytes(chunk_size);
+    bsoncxx::builder::stream::document metadata{};
+    options.metadata(metadata << "sha256" << sha256.toStdString() << bsoncxx::builder::stream::finalize);
+    mongocxx::gridfs::uploader uploader = _gridfs_bucket.open_upload_stream(file_name, options);
+
+    // Only one chunk is kept in memory
+    QByteArray chunk(chunk_size, Qt::Uninitialized);
+    qint64 read_size;
+    qint64 uploaded_size = 0;
+    while((read_size = file.read(chunk.data(), chunk.size())) > 0)
+    {
+        uploader.write(reinterpret_cast<const std::uint8_t*>(chunk.constData()), std::size_t(read_size));
+        uploaded_size += read_size;
+    }
 
-    bsoncxx::types::b_oid bson_oid = bson_id.get_oid();
-    bsoncxx::oid bson_oid_value = bson_oid.value;
-    QString id = QString::fromStdString(bson_oid_value.to_string());
+    // The file must not change between both passes, otherwise the hash of the metadata would be wrong. The content
+    // is not hashed again, a change is detected by the size and the modification time of the file.
+    if(read_size < 0 || uploaded_size != hashed_size || QFileInfo(file_path).lastModified() != hashed_modified)
+    {
+        // Remove the chunks that were already uploaded
+        uploader.abort();
+        _logger->add(_m_type.ERROR, "In function: addFileGridFS, failed to read or file modified during the upload: ", file_path);
+        return QString();
+    }
 
+    mongocxx::result::gridfs::upload result = uploader.close();
+    QString id = QString::fromStdString(result.id().get_oid().value.to_string());
+    _logger->add(_m_type.INFO, "File: ", file_path, " uploaded with GridFS, id: ", id, " size: ", QString::number(uploaded_size));
     return id;
 }
 
 /**
- * For files bigger than 16 Mb, use the GridFS library to download a file from the database.
+ * Look for a GridFS file of the current database with the given content hash and size.
+ *
+ * @param  sha256 SHA-256 of the content in hexadecimal (as saved in metadata.sha256).
+ * @param  length Size of the file in bytes.
+ * @return Id of the file, empty if there is none.
+ *
+ */
+
+QString mongodb_manager::findFileGridFS(QString sha256, qint64 length)
+{
+    mongocxx::collection files_collection = (*_conn)[_current_database_name.toStdString()][GRIDFS_FILES_COLLECTION.toStdString()];
+
+    // The lookup is done on every upload, create its index the first time (it does nothing if it already exists)
+    if(!_gridfs_hash_indexed.contains(_current_database_name))
+    {
+        bsoncxx::builder::stream::document index{};
+        files_collection.create_index(index << "metadata.sha256" << 1 << "length" << 1 << bsoncxx::builder::stream::finalize);
+        _gridfs_hash_indexed.insert(_current_database_name);
+    }
+
+    bsoncxx::builder::stream::document filter{};
+    filter << "metadata.sha256" << sha256.toStdString() << "length" << static_cast<std::int64_t>(length);
+
+    mongocxx::options::find options{};
+    bsoncxx::builder::stream::document projection{};
+    options.projection(projection << "_id" << 1 << bsoncxx::builder::stream::finalize);
+
+    bsoncxx::stdx::optional<bsoncxx::document::value> file_document = files_collection.find_one(filter.view(), options);
+    if(!file_document)
+    {
+        return QString();
+    }
+    return mongodb_document::getIdFromBsoncxx(file_document->view());
+}
+
+/**
+ * Open a GridFS download stream for a file.
  *
  * @param id Id of the file (This file should belong to the fs.files collection!!!)
- * @return Content of the file.
+ * @return Downloader of the file.
  *
  */
 
-mongodb_document mongodb_manager::getDocumentGridFS(QString id)
+mongocxx::gridfs::downloader mongodb_manager::openDownloadStreamGridFS(QString id)
 {
     // Initialize connection to GridFS
     connectGridFS(_current_database_name);
 
-    // Build a valid mongodb id structure
-    bsoncxx::builder::stream::document id_stream{};
-    bsoncxx::document::value id_doc_value = id_stream << "_id" << bsoncxx::oid(id.toStdString()) << bsoncxx::builder::stream::finalize;
-    bsoncxx::document::view id_doc_view = id_doc_value.view();
+    // The open_download_stream method requires bsoncxx::types::bson_value::value
+    bsoncxx::types::bson_value::value id_types_value{bsoncxx::types::b_oid{bsoncxx::oid(id.toStdString())}};
 
-    // The open_download_stream method requires bsoncxx::types::value, therefore a conversion from bsoncxx::document::value is needed
-    bsoncxx::document::element doc_element = id_doc_view["_id"];
-    bsoncxx::types::bson_value::value id_types_value{doc_element.get_value()};
+    return _gridfs_bucket.open_download_stream(id_types_value);
+}
 
-    // Strat the downloader with the given id
-    mongocxx::gridfs::downloader downloader = _gridfs_bucket.open_download_stream(id_types_value);
-    // Get the lenght of the file to be downloaded in a std::vector
-    std::int64_t file_length = downloader.files_document()["length"].get_int64().value;
-    // Initialize the vector where the downloaded file will be saved
-    std::vector<std::uint8_t> file_download_vector((int(file_length)));
-    std::uint8_t *big_file_download = &file_download_vector[0];
-    // Read the file and save it into the vector
-    downloader.read(big_file_download, file_length);
+/**
+ * Read the beginning of a GridFS file, used to preview files without downloading them completely.
+ *
+ * @param id Id of the file (This file should belong to the fs.files collection!!!)
+ * @param max_size Maximum number of bytes to be read (limited to MAX_PREVIEW_SIZE).
+ * @param file_length Size of the whole file (optional).
+ * @return First bytes of the file.
+ *
+ */
+
+QByteArray mongodb_manager::previewFileGridFS(QString id, qint64 max_size, qint64 *file_length)
+{
+    mongocxx::gridfs::downloader downloader = mongodb_manager::openDownloadStreamGridFS(id);
+    qint64 length = qint64(downloader.file_length());
+    if(file_length != nullptr)
+    {
+        *file_length = length;
+    }
 
-    // Convert the content of the std::vector to a QByte array
-    QByteArray* json_QByte = new QByteArray(reinterpret_cast<const char*>(file_download_vector.data()), file_download_vector.size());
+    // Only the chunks that contain the first max_size bytes are fetched
+    qint64 preview_size = std::max<qint64>(0, std::min(std::min(max_size, MAX_PREVIEW_SIZE), length));
+    QByteArray preview(int(preview_size), Qt::Uninitialized);
+    std::size_t read_size = downloader.read(reinterpret_cast<std::uint8_t*>(preview.data()), std::size_t(preview.size()));
+    preview.truncate(int(read_size));
+    downloader.close();
 
-    return *json_QByte;
+    return preview;
 }
 
+/**
+ * Download a GridFS file to disk. The file is read in chunks that are written to the destination as they arrive,
+ * so the memory used doesn't depend on the size of the file.
+ *
+ * @param id Id of the file (This file should belong to the fs.files collection!!!)
+ * @param file_path Path of the destination file.
+ * @param progress Function called after each chunk with the bytes written and the size of the file, returning false cancels the download (optional).
+ * @param chunk_size Size of the reads.
+ * @return True if the whole file was downloaded, false otherwise (the incomplete destination file is removed).
+ *
+ */
+
+bool mongodb_manager::downloadFileGridFS(QString id, QString file_path, std::function<bool(qint64, qint64)> progress, int chunk_size)
+{
+    QFile output_file(file_path);
+    if(file_path.isEmpty() || chunk_size < 1 || !output_file.open(QFile::WriteOnly | QFile::Truncate))
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadFileGridFS, failed to open: ", file_path);
+        return false;
+    }
+
+    mongocxx::gridfs::downloader downloader = mongodb_manager::openDownloadStreamGridFS(id);
+    qint64 file_length = qint64(downloader.file_length());
+    qint64 written = 0;
+
+    // Only one chunk is kept in memory
+    QByteArray chunk(chunk_size, Qt::Uninitialized);
+    while(written < file_length)
+    {
+        std::size_t read_size = downloader.read(reinterpret_cast<std::uint8_t*>(chunk.data()), std::size_t(chunk.size()));
+        if(read_size == 0 || output_file.write(chunk.constData(), qint64(read_size)) != qint64(read_size))
+        {
+            break;
+        }
+        written += qint64(read_size);
+
+        if(progress && !progress(written, file_length))
+        {
+            break;
+        }
+    }
+    downloader.close();
+    output_file.close();
+
+    if(written != file_length)
+    {
+        output_file.remove();
+        _logger->add(_m_type.ERROR, "In function: downloadFileGridFS, download of: ", id, " incomplete, bytes written: ", QString::number(written));
+        return false;
+    }
+
+    _logger->add(_m_type.INFO, "GridFS file: ", id, " downloaded to: ", file_path, " size: ", QString::number(file_length));
+    return true;
+}
+
+/**
+ * Download a GridFS file to disk fetching its chunks in parallel. The range of chunks is split between several workers,
+ * each one with its own connection from a pool, that read their chunks with a range query on fs.chunks and write them
+ * at their offset of the preallocated destination file. Small files are downloaded with downloadFileGridFS().
+ *
+ * @param id Id of the file (This file should belong to the fs.files collection!!!)
+ * @param file_path Path of the destination file.
+ * @param worker_count Number of workers.
+ * @param progress Function called periodically with the bytes written and the size of the file, returning false cancels the download (optional).
+ * @return True if the whole file was downloaded, false otherwise (the incomplete destination file is removed).
+ *
+ */
+
+bool mongodb_manager::downloadFileGridFSParallel(QString id, QString file_path, int worker_count, std::function<bool(qint64, qint64)> progress)
+{
+    // Read the length and the chunk size of the file
+    std::string database = _current_database_name.toStdString();
+    bsoncxx::oid file_id(id.toStdString());
+    bsoncxx::builder::stream::document filter{};
+    bsoncxx::stdx::optional<bsoncxx::document::value> file_document = (*_conn)[database][GRIDFS_FILES_COLLECTION.toStdString()].find_one(filter << "_id" << file_id << bsoncxx::builder::stream::finalize);
+    if(!file_document)
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadFileGridFSParallel, file: ", id, " not found in ", GRIDFS_FILES_COLLECTION);
+        return false;
+    }
+
+    BsoncxxDocView file_view = file_document->view();
+    bsoncxx::document::element length_element = file_view["length"];
+    qint64 file_length = length_element.type() == bsoncxx::type::k_int32 ? qint64(length_element.get_int32().value) : qint64(length_element.get_int64().value);
+    qint64 chunk_size = qint64(file_view["chunkSize"].get_int32().value);
+    qint64 chunk_count = chunk_size > 0 ? (file_length + chunk_size - 1) / chunk_size : 0;
+
+    // Not worth the extra connections
+    if(worker_count < 2 || chunk_count < 2 * qint64(worker_count))
+    {
+        return mongodb_manager::downloadFileGridFS(id, file_path, progress);
+    }
+
+    // Preallocate the destination file, the workers write their chunks in place
+    QFile output_file(file_path);
+    if(!output_file.open(QFile::WriteOnly | QFile::Truncate) || !output_file.resize(file_length))
+    {
+        _logger->add(_m_type.ERROR, "In function: downloadFileGridFSParallel, failed to create: ", file_path);
+        return false;
+    }
+    output_file.close();
+
+    if(!_pool)
+    {
+        _pool = std::make_shared<mongocxx::pool>(mongocxx::uri{_uri});
+    }
+
+    std::atomic<qint64> written{0};
+    std::atomic<bool> cancel{false};
+    QList<QFuture<bool>> workers;
+
+    // Split the chunk index range [0, chunk_count) between the workers
+    qint64 chunks_per_worker = (chunk_count + worker_count - 1) / worker_count;
+    for(qint64 first = 0; first < chunk_count; first += chunks_per_worker)
+    {
+        qint64 last = std::min(first + chunks_per_worker, chunk_count);
+        workers.push_back(QtConcurrent::run([=, &written, &cancel]()
+        {
+            return mongodb_manager::downloadChunksGridFS(database, file_id, chunk_size, first, last, file_path, &written, &cancel);
+        }));
+    }
+
+    // Report the progress while the workers run
+    bool running = true;
+    while(running)
+    {
+        running = false;
+        for(QFuture<bool> &worker : workers)
+        {
+            if(!worker.isFinished())
+            {
+                running = true;
+            }
+            else if(!worker.result())
+            {
+                // One worker failed, the others can stop
+                cancel = true;
+            }
+        }
+        if(progress && !progress(written.load(), file_length))
+        {
+            cancel = true;
+        }
+        if(running)
+        {
+            QThread::msleep(50);
+        }
+    }
+
+    bool downloaded = !cancel;
+
+    if(!downloaded || written.load() != file_length)
+    {
+        output_file.remove();
+        _logger->add(_m_type.ERROR, "In function: downloadFileGridFSParallel, download of: ", id, " incomplete, bytes written: ", QString::number(written.load()));
+        return false;
+    }
+
+    _logger->add(_m_type.INFO, "GridFS file: ", id, " downloaded to: ", file_path, " workers: ", QString::number(workers.size()));
+    return true;
+}
+
+/**
+ * Worker of downloadFileGridFSParallel(). Fetch the chunks [first, last) of a GridFS file with its own connection
+ * and write them at their offset of the destination file. It doesn't use the logger, since it runs on another thread.
+ *
+ * @param database Name of the database of the bucket.
+ * @param file_id Id of the file.
+ * @param chunk_size Size of the chunks of the file.
+ * @param first Index of the first chunk.
+ * @param last Index after the last chunk.
+ * @param file_path Path of the (preallocated) destination file.
+ * @param written Counter of bytes written, shared by the workers.
+ * @param cancel Flag to stop the worker.
+ * @return True if all the chunks were written, false otherwise.
+ *
+ */
+
+bool mongodb_manager::downloadChunksGridFS(std::string database, bsoncxx::oid file_id, qint64 chunk_size, qint64 first, qint64 last, QString file_path, std::atomic<qint64> *written, std::atomic<bool> *cancel)
+{
+    QFile output_file(file_path);
+    if(!output_file.open(QFile::ReadWrite))
+    {
+        return false;
+    }
+
+    try
+    {
+        mongocxx::pool::entry client = _pool->acquire();
+
+        bsoncxx::builder::stream::document filter{};
+        filter << "files_id" << file_id << "n" << bsoncxx::builder::stream::open_document <<
+                  "$gte" << static_cast<std::int32_t>(first) << "$lt" << static_cast<std::int32_t>(last) <<
+                  bsoncxx::builder::stream::close_document;
+
+        mongocxx::options::find options{};
+        bsoncxx::builder::stream::document sort{};
+        options.sort(sort << "n" << 1 << bsoncxx::builder::stream::finalize);
+
+        qint64 expected = first;
+        mongocxx::cursor cursor = (*client)[database][GRIDFS_CHUNKS_COLLECTION.toStdString()].find(filter.view(), options);
+        for(bsoncxx::document::view chunk : cursor)
+        {
+            qint64 n = qint64(chunk["n"].get_int32().value);
+            bsoncxx::types::b_binary data = chunk["data"].get_binary();
+
+            // The chunks must be consecutive and all of them full except the last one of the file
+            if(*cancel || n != expected || qint64(data.size) > chunk_size)
+            {
+                return false;
+            }
+
+            if(!output_file.seek(n * chunk_size) || output_file.write(reinterpret_cast<const char*>(data.bytes), qint64(data.size)) != qint64(data.size))
+            {
+                return false;
+            }
+            *written += qint64(data.size);
+            expected++;
+        }
+        return expected == last;
+    }
+    catch(const std::exception&)
+    {
+        return false;
+    }
+}
 
 /**
  * Save the users roles table to ./UsersAndRoles.csv file.
@@ -2,6 +2,8 @@
 #define MONGODB_COLLECTION_H
 
 /// \cond
+#include <QHash>
+#include <QSet>
 #include <QVariantMap>
 #include <QByteArray>
 #include <QString>
@@ -11,9 +13,14 @@
     #include <mongocxx/database.hpp>
     #include <mongocxx/exception/server_error_code.hpp>
     #include <mongocxx/instance.hpp>
+    #include <mongocxx/pool.hpp>
+    #include <bsoncxx/oid.hpp>
     #include <bsoncxx/types/bson_value/value.hpp>
 #endif
 
+#include <atomic>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 /// \endcond
@@ -21,6 +28,9 @@
 #include <mongodb_structures.h>
 #include <mongodb_logger.h>
 #include <mongodb_document.h>
+#include <mongodb_document_cursor.h>
+#include <mongodb_document_cache.h>
+#include <mongodb_schema.h>
 
 /**
  * @brief Backbone class to manage connection and acces to MongoDB.
@@ -30,6 +40,9 @@ class mongodb_manager{
 
 public:
 
+    // Maximum number of bytes read by previewFileGridFS(), bigger files have to be downloaded
+    static constexpr qint64 MAX_PREVIEW_SIZE = 16 * 1024 * 1024;
+
     mongodb_manager(QString database_MongoDB_name, QString collection_MongoDB_name);
     mongodb_manager();
 
@@ -44,21 +57,32 @@ public:
 
     // Document management:
     mongodb_document getDocument(QString id);
-    mongodb_document getDocumentGridFS(QString file_id);
+    mongodb_document getDocument(QString id, BsoncxxDocView projection);
+    QByteArray previewFileGridFS(QString file_id, qint64 max_size, qint64 *file_length = nullptr);
+    bool downloadFileGridFS(QString file_id, QString file_path, std::function<bool(qint64, qint64)> progress = nullptr, int chunk_size = 255 * 1024);
+    bool downloadFileGridFSParallel(QString file_id, QString file_path, int worker_count = 4, std::function<bool(qint64, qint64)> progress = nullptr);
     void getDocumentList(QStringList *id_list, std::vector<mongodb_document> *document_list);
-    bool exportDocument(QString id, QString file_name);
+    mongodb_document_cursor openDocumentCursor(mongodb_cursor_options options = mongodb_cursor_options());
+    bool createQueryOptions(QString filter, QString sort, QString projection, int limit, mongodb_cursor_options *options);
+    bool exportDocument(QString id, QString file_name, bool compact = false);
     void importDocument(QString file_path);
+    bool importDocuments(QString file_path, int batch_size = 1000, qint64 *inserted_count = nullptr, qint64 *failed_count = nullptr);
     QString addDocument(mongodb_document document, QString id);
-    QString addDocument(mongodb_document document);
-    QString addDocumentGridFS(QString document, std::string file_name);
-    bool deleteDocument(QString id);
+    QString addDocument(const mongodb_document &document);
+    QString upsertDocument(const mongodb_document &document, bool *inserted);
+    QString addFileGridFS(QString file_path, std::string file_name, int chunk_size = 255 * 1024);
+    bool deleteDocument(const bsoncxx::types::bson_value::value &id);
+    int deleteDocuments(const std::vector<bsoncxx::types::bson_value::value> &id_list);
 
     // Collection management:
     void getCollectionList(QString database, QStringList *collection_list);
     bool addCollection(QString database, QString collection);
     bool deleteCollection(QString database, QString collection);
-    void downloadCollection(QString file_name);
+    bool downloadCollection(QString file_name, QString format, bool compact = true);
+    bool dumpCollection(QString file_name);
+    bool restoreCollection(QString file_path, int batch_size = 1000, qint64 *inserted_count = nullptr, qint64 *failed_count = nullptr);
     bool verifyCollection(QString database, QString collection);
+    bool getCollectionSchema(int sample_size, mongodb_schema *schema, bool refresh = false);
 
     // Database management:
     virtual void getDatabaseList(QStringList *database_list);
@@ -85,12 +109,18 @@ public:
     void clearDatabaseRoles(QString database);
     bool verifyRole(QString role);
 
+    // Document cache:
+    void setDocumentCacheSize(qint64 max_size);
+
     // Logger:
     virtual void setCustomLogger(mongodb_logger *custom_logger);
     void printlog();
 
     // Utilities:
     bsoncxx::document::value createTemplate(QString option, QString field1 = QString(""), QString field2 = QString(""), QString field3 = QString(""));
+    bsoncxx::document::value createIdFilter(QString id);
+    bsoncxx::document::value createIdFilter(QStringList id_list);
+    bsoncxx::document::value createIdFilter(const std::vector<bsoncxx::types::bson_value::value> &id_list);
 
 
 private:
@@ -99,6 +129,8 @@ private:
     mongocxx::database _database_MDB;
     mongocxx::collection _collection_MDB;
     mongocxx::gridfs::bucket _gridfs_bucket;
+    std::string _uri;
+    std::shared_ptr<mongocxx::pool> _pool;     // Connections for the workers of parallel operations (created on demand)
 
     // General information:
     QString _user;
@@ -107,8 +139,25 @@ private:
     QString ADMIN_DB = "admin";
     QString ADMIN_DB_EXTEND = "admin.";
     QString USERS_COLLECTION = "system.users";
+    // Collections of the default GridFS bucket (see connectGridFS()):
+    QString GRIDFS_FILES_COLLECTION = "fs.files";
+    QString GRIDFS_CHUNKS_COLLECTION = "fs.chunks";
+
+    // Databases where the index used by findFileGridFS() has been created:
+    QSet<QString> _gridfs_hash_indexed;
+
+    // Cache of the documents read from MongoDB:
+    mongodb_document_cache _document_cache;
+
+    // Schemas inferred for each collection (see getCollectionSchema()):
+    QHash<QString, mongodb_schema> _schema_cache;
 
     // Utilities:
+    void insertDocumentBatch(std::vector<bsoncxx::document::view> &documents, qint64 *inserted_count, qint64 *failed_count);
+    mongocxx::gridfs::downloader openDownloadStreamGridFS(QString id);
+    QString findFileGridFS(QString sha256, qint64 length);
+    bool downloadChunksGridFS(std::string database, bsoncxx::oid file_id, qint64 chunk_size, qint64 first, qint64 last, QString file_path, std::atomic<qint64> *written, std::atomic<bool> *cancel);
+    void getUserRolesFromBsoncxx(BsoncxxDocView user_document, const QStringList &database_list, QStringList *user_roles_list);
     mongodb_actions _actions;
     mongodb_message_types _m_type;
     mongodb_logger *_logger;
@@ -0,0 +1,183 @@
+#include <mongodb_schema.h>
+
+/**
+ * Get the schema of a single document. Used to analyze the documents on worker threads and merge the results.
+ *
+ * @param document Document to be analyzed.
+ * @return schema Schema of the document.
+ *
+ **/
+mongodb_schema mongodb_schema::fromDocument(const mongodb_document &document)
+{
+    mongodb_schema schema;
+    schema.addDocument(document.toBsoncxxDocView());
+    return schema;
+}
+
+/**
+ * Get the name of a BSON type (same names as the $type operator of MongoDB).
+ *
+ * @param type BSON type.
+ * @return name Name of the type.
+ *
+ **/
+QString mongodb_schema::typeName(bsoncxx::type type)
+{
+    switch(type)
+    {
+    case bsoncxx::type::k_double:       return "double";
+    case bsoncxx::type::k_utf8:         return "string";
+    case bsoncxx::type::k_document:     return "object";
+    case bsoncxx::type::k_array:        return "array";
+    case bsoncxx::type::k_binary:       return "binData";
+    case bsoncxx::type::k_undefined:    return "undefined";
+    case bsoncxx::type::k_oid:          return "objectId";
+    case bsoncxx::type::k_bool:         return "bool";
+    case bsoncxx::type::k_date:         return "date";
+    case bsoncxx::type::k_null:         return "null";
+    case bsoncxx::type::k_regex:        return "regex";
+    case bsoncxx::type::k_dbpointer:    return "dbPointer";
+    case bsoncxx::type::k_code:         return "javascript";
+    case bsoncxx::type::k_symbol:       return "symbol";
+    case bsoncxx::type::k_codewscope:   return "javascriptWithScope";
+    case bsoncxx::type::k_int32:        return "int";
+    case bsoncxx::type::k_timestamp:    return "timestamp";
+    case bsoncxx::type::k_int64:        return "long";
+    case bsoncxx::type::k_decimal128:   return "decimal";
+    case bsoncxx::type::k_maxkey:       return "maxKey";
+    case bsoncxx::type::k_minkey:       return "minKey";
+    default:                            return "unknown";
+    }
+}
+
+/**
+ * Add the fields of a document to the schema. Each field and type is counted once per document, even if it
+ * appears several times (e.g. inside the elements of an array).
+ *
+ * @param document Document to be added.
+ *
+ **/
+void mongodb_schema::addDocument(BsoncxxDocView document)
+{
+    // Types found for each path of the document
+    QMap<QString, QStringList> document_fields;
+    mongodb_schema::addFields(document, QString(), &document_fields);
+
+    for(auto it = document_fields.constBegin(); it != document_fields.constEnd(); ++it)
+    {
+        mongodb_schema_field &field = _fields[it.key()];
+        field.path = it.key();
+        field.count++;
+        for(const QString &type : it.value())
+        {
+            field.types[type]++;
+        }
+    }
+    _document_count++;
+}
+
+/**
+ * Add the fields of a (sub)document.
+ *
+ * @param document Document to be analyzed.
+ * @param prefix Path of the document ("" for the top level).
+ * @param document_fields Container for the types of each path.
+ *
+ **/
+void mongodb_schema::addFields(BsoncxxDocView document, const QString &prefix, QMap<QString, QStringList> *document_fields)
+{
+    for(const bsoncxx::document::element &element : document)
+    {
+        bsoncxx::stdx::string_view key = element.key();
+        QString path = prefix.isEmpty() ? QString() : prefix + ".";
+        path.append(QString::fromUtf8(key.data(), int(key.size())));
+        mongodb_schema::addValue(element.get_value(), path, document_fields);
+    }
+}
+
+/**
+ * Add the elements of an array, all of them share the path prefix + "[]".
+ *
+ * @param array Array to be analyzed.
+ * @param prefix Path of the array.
+ * @param document_fields Container for the types of each path.
+ *
+ **/
+void mongodb_schema::addFields(bsoncxx::array::view array, const QString &prefix, QMap<QString, QStringList> *document_fields)
+{
+    QString path = prefix + "[]";
+    for(const bsoncxx::array::element &element : array)
+    {
+        mongodb_schema::addValue(element.get_value(), path, document_fields);
+    }
+}
+
+/**
+ * Add a value and, for documents and arrays, its content.
+ *
+ * @param value Value to be analyzed.
+ * @param path Path of the value.
+ * @param document_fields Container for the types of each path.
+ *
+ **/
+void mongodb_schema::addValue(const bsoncxx::types::bson_value::view &value, const QString &path, QMap<QString, QStringList> *document_fields)
+{
+    QStringList &types = (*document_fields)[path];
+    QString type = mongodb_schema::typeName(value.type());
+    if(!types.contains(type))
+    {
+        types.push_back(type);
+    }
+
+    if(value.type() == bsoncxx::type::k_document)
+    {
+        mongodb_schema::addFields(value.get_document().value, path, document_fields);
+    }
+    else if(value.type() == bsoncxx::type::k_array)
+    {
+        mongodb_schema::addFields(value.get_array().value, path, document_fields);
+    }
+}
+
+/**
+ * Merge another schema into this one.
+ *
+ * @param schema Schema to be merged.
+ *
+ **/
+void mongodb_schema::merge(const mongodb_schema &schema)
+{
+    for(const mongodb_schema_field &other_field : schema._fields)
+    {
+        mongodb_schema_field &field = _fields[other_field.path];
+        field.path = other_field.path;
+        field.count += other_field.count;
+        for(auto it = other_field.types.constBegin(); it != other_field.types.constEnd(); ++it)
+        {
+            field.types[it.key()] += it.value();
+        }
+    }
+    _document_count += schema._document_count;
+}
+
+/**
+ * Get the number of documents analyzed.
+ *
+ * @return Number of documents.
+ *
+ **/
+qint64 mongodb_schema::getDocumentCount() const
+{
+    return _document_count;
+}
+
+/**
+ * Get the fields of the schema sorted by path.
+ *
+ * @return List of fields.
+ *
+ **/
+QList<mongodb_schema_field> mongodb_schema::getFields() const
+{
+    return _fields.values();
+}
@@ -0,0 +1,54 @@
+#ifndef MONGODB_SCHEMA_H
+#define MONGODB_SCHEMA_H
+
+/// \cond
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#ifndef Q_MOC_RUN
+    #include <bsoncxx/array/view.hpp>
+    #include <bsoncxx/document/view.hpp>
+    #include <bsoncxx/types.hpp>
+#endif
+/// \endcond
+
+#include <mongodb_document.h>
+
+/**
+ * @brief Field of a collection schema.
+ */
+
+struct mongodb_schema_field
+{
+    QString path;                   /**< Path of the field, "[]" stands for the elements of an array (e.g. items[].name). */
+    QMap<QString, qint64> types;    /**< Number of documents in which the field has each type. */
+    qint64 count = 0;               /**< Number of documents in which the field is present. */
+};
+
+/**
+ * @brief Schema of a collection inferred from a set of documents: paths of the fields, their types and how often they are present.
+ */
+
+class mongodb_schema
+{
+private:
+    QMap<QString, mongodb_schema_field> _fields;
+    qint64 _document_count = 0;
+
+    void addFields(BsoncxxDocView document, const QString &prefix, QMap<QString, QStringList> *document_fields);
+    void addFields(bsoncxx::array::view array, const QString &prefix, QMap<QString, QStringList> *document_fields);
+    void addValue(const bsoncxx::types::bson_value::view &value, const QString &path, QMap<QString, QStringList> *document_fields);
+
+public:
+    static mongodb_schema fromDocument(const mongodb_document &document);
+    static QString typeName(bsoncxx::type type);
+
+    void addDocument(BsoncxxDocView document);
+    void merge(const mongodb_schema &schema);
+
+    qint64 getDocumentCount() const;
+    QList<mongodb_schema_field> getFields() const;
+};
+
+#endif // MONGODB_SCHEMA_H
@@ -41,4 +41,15 @@ struct mongodb_message_types
     QString ALL = "ALL";
 };
 
+/**
+ * @brief File formats used to export a collection
+*/
+
+struct mongodb_export_formats
+{
+    QString JSON_ARRAY = "json";    /**< One Json array with all the documents */
+    QString NDJSON = "ndjson";      /**< One Json document per line */
+    QString BSON = "bson";          /**< Raw BSON documents (mongodump format) */
+};
+
 #endif // MONGODB_STRUCTURES_H